@@ -0,0 +1,314 @@
+#include "charactersheet/changejournal.h"
+
+#include <QCborMap>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QCborValue>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "charactersheet/fieldvalue.h"
+#include "tablefield.h"
+
+namespace
+{
+// pending records are written at once past this size, whatever the flush interval.
+constexpr qsizetype maxPendingSize= 64 * 1024;
+
+bool syncToDisk(QFile& file)
+{
+    if(!file.flush())
+        return false;
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
+
+// the worker syncs its own copy of the handle, the journal may be closed or replaced meanwhile.
+int duplicateHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    return _dup(handle);
+#else
+    return dup(handle);
+#endif
+}
+
+bool syncHandle(int handle)
+{
+#ifdef Q_OS_WIN
+    auto const synced= _commit(handle) == 0;
+    _close(handle);
+#else
+    auto const synced= fsync(handle) == 0;
+    ::close(handle);
+#endif
+    return synced;
+}
+} // namespace
+
+ChangeJournal::ChangeJournal(CharacterSheetModel* model, QObject* parent) : QObject(parent), m_model(model)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(1000);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ChangeJournal::flush);
+    if(m_model)
+        connect(m_model, &CharacterSheetModel::fieldChanged, this, &ChangeJournal::record);
+}
+
+ChangeJournal::~ChangeJournal()
+{
+    close();
+}
+
+QString ChangeJournal::journalPath(const QString& rcsPath)
+{
+    return rcsPath + QStringLiteral(".journal");
+}
+
+bool ChangeJournal::open(const QString& rcsPath)
+{
+    close();
+    m_error.clear();
+    ++m_generation;
+    m_rcsPath= rcsPath;
+    m_file.setFileName(journalPath(rcsPath));
+    if(!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+        return setError(m_file.errorString());
+    return true;
+}
+
+void ChangeJournal::close()
+{
+    if(!m_file.isOpen())
+        return;
+
+    flush();
+    // the last records are on the disk when the journal is closed.
+    m_sync.waitForFinished();
+    m_syncAgain= false;
+    if(!syncToDisk(m_file))
+        setError(m_file.errorString());
+    m_file.close();
+    ++m_generation;
+}
+
+bool ChangeJournal::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+int ChangeJournal::replay()
+{
+    if(!m_file.isOpen() || !m_model)
+        return -1;
+
+    flush();
+    m_file.seek(0);
+    auto const data= m_file.readAll();
+
+    int count= 0;
+    qint64 validEnd= 0;
+    m_replaying= true;
+    QCborStreamReader reader(data);
+    while(reader.currentOffset() < data.size())
+    {
+        auto const value= QCborValue::fromCbor(reader);
+        if(reader.lastError() != QCborError::NoError)
+            break;
+        validEnd= reader.currentOffset();
+
+        auto const array= value.toArray();
+        auto const uuid= array.at(0).toString();
+        auto const parent= array.at(1).toString();
+        auto const id= array.at(2).toString();
+        auto const map= array.at(3).toMap();
+
+        QJsonObject json;
+        if(map.value(qint64(FieldValue::CborTypeKey)).toString() == QStringLiteral("TableField"))
+            json= map.value(qint64(FieldValue::CborTableKey)).toMap().toJsonObject();
+        else
+            FieldValue::fromCbor(map, id, nullptr).toJson(json);
+        // lines added to a table share the ids of the first one.
+        if(array.size() > 4)
+            json["line"]= static_cast<int>(array.at(4).toInteger());
+
+        if(m_model->setFieldData(uuid, json, parent))
+            ++count;
+    }
+    m_replaying= false;
+
+    // the last record has been cut by a crash, new records must not follow it.
+    if(validEnd < data.size())
+    {
+        m_file.resize(validEnd);
+        syncToDisk(m_file);
+    }
+    return count;
+}
+
+QFuture<bool> ChangeJournal::compact(const QJsonObject& snapshot)
+{
+    if(m_compaction.isRunning())
+        return m_compaction;
+
+    flush();
+    auto const offset= m_file.isOpen() ? m_file.size() : 0;
+    auto const fileName= m_file.fileName();
+    auto const generation= m_generation;
+    auto const path= m_rcsPath;
+    auto writing= QtConcurrent::run(
+        [path, snapshot]()
+        {
+            QSaveFile file(path);
+            if(!file.open(QIODevice::WriteOnly))
+                return false;
+            file.write(QJsonDocument(snapshot).toJson(QJsonDocument::Compact));
+            return file.commit();
+        });
+    m_compaction= writing.then(this,
+                               [this, fileName, generation, offset](bool written)
+                               {
+                                   if(written)
+                                       dropUntil(fileName, generation, offset);
+                                   return written;
+                               });
+    return m_compaction;
+}
+
+bool ChangeJournal::flush()
+{
+    m_flushTimer.stop();
+    if(m_pending.isEmpty() || !m_file.isOpen())
+        return true;
+
+    auto const written= m_file.write(m_pending);
+    m_pending.clear();
+    if(written < 0 || !m_file.flush())
+        return setError(m_file.errorString());
+    // the records are in the system, editions do not wait for the disk.
+    syncLater();
+    return true;
+}
+
+void ChangeJournal::syncLater()
+{
+    if(m_sync.isRunning())
+    {
+        m_syncAgain= true;
+        return;
+    }
+
+    auto const handle= duplicateHandle(m_file.handle());
+    if(handle < 0)
+    {
+        if(!syncToDisk(m_file))
+            setError(m_file.errorString());
+        return;
+    }
+    m_sync= QtConcurrent::run([handle]() { return syncHandle(handle); });
+    m_sync.then(this,
+                [this](bool synced)
+                {
+                    if(!synced)
+                        setError(tr("The journal could not be synced to disk"));
+                    // records written while the worker was syncing.
+                    if(std::exchange(m_syncAgain, false) && m_file.isOpen())
+                        syncLater();
+                });
+}
+
+void ChangeJournal::setFlushInterval(int msec)
+{
+    m_flushTimer.setInterval(msec);
+}
+
+int ChangeJournal::flushInterval() const
+{
+    return m_flushTimer.interval();
+}
+
+QString ChangeJournal::errorString() const
+{
+    return m_error;
+}
+
+void ChangeJournal::record(CharacterSheet* sheet, CharacterSheetItem* item, const QString& parent)
+{
+    if(m_replaying || !m_file.isOpen() || nullptr == sheet || nullptr == item)
+        return;
+
+    // [uuid, table path, field id, field record(, table line)], the field record is the one of the binary model.
+    auto const table= dynamic_cast<TableField*>(item->getParent());
+    auto const line= nullptr == table ? -1 : table->getModel()->lineOfField(dynamic_cast<FieldController*>(item));
+    QCborStreamWriter writer(&m_pending);
+    writer.startArray(line < 0 ? 4 : 5);
+    writer.append(sheet->uuid());
+    writer.append(parent);
+    writer.append(item->getId());
+    if(item->getItemType() == CharacterSheetItem::TableItem)
+    {
+        QJsonObject json;
+        item->saveDataItem(json);
+        writer.startMap(2);
+        writer.append(qint64(FieldValue::CborTypeKey));
+        writer.append(QStringLiteral("TableField"));
+        writer.append(qint64(FieldValue::CborTableKey));
+        QCborValue::fromJsonValue(json).toCbor(writer);
+        writer.endMap();
+    }
+    else
+    {
+        FieldValue::fromItem(item).toCbor(writer, nullptr);
+    }
+    if(line >= 0)
+        writer.append(line);
+    writer.endArray();
+
+    if(m_pending.size() >= maxPendingSize)
+        flush();
+    else if(!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void ChangeJournal::dropUntil(const QString& fileName, quint64 generation, qint64 offset)
+{
+    // the offset is only valid in the journal the compaction started with.
+    if(!m_file.isOpen() || generation != m_generation || fileName != m_file.fileName())
+        return;
+
+    // records written during the compaction are kept, the journal is replaced at once so a crash loses nothing.
+    flush();
+    m_file.seek(offset);
+    auto const tail= m_file.readAll();
+
+    QSaveFile file(m_file.fileName());
+    if(!file.open(QIODevice::WriteOnly) || file.write(tail) != tail.size() || !file.commit())
+    {
+        setError(file.errorString());
+        return;
+    }
+
+    m_file.close();
+    if(!m_file.open(QIODevice::ReadWrite | QIODevice::Append))
+        setError(m_file.errorString());
+}
+
+bool ChangeJournal::setError(const QString& error)
+{
+    if(m_error.isEmpty())
+        m_error= error;
+    return false;
+}
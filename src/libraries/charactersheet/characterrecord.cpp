@@ -0,0 +1,148 @@
+#include "characterrecord.h"
+
+#include <QCborMap>
+#include <QJsonArray>
+#include <QCborValue>
+#include <algorithm>
+
+namespace
+{
+void appendCborField(CharacterRecord& record, const QString& key, const QCborValue& value, bool fromSchema)
+{
+    if(!value.isMap())
+        return;
+
+    auto const map= value.toMap();
+    if(map.value(qint64(FieldValue::CborTypeKey)).toString() == QStringLiteral("TableField"))
+    {
+        auto const json= map.value(qint64(FieldValue::CborTableKey)).toMap().toJsonObject();
+        auto table= TableRecord::fromJson(json);
+        table.value.id= key;
+        record.tables.append(table);
+        return;
+    }
+
+    CharacterRecord::Field field;
+    field.value= FieldValue::fromCbor(map, key, nullptr);
+    field.labelFromSchema= fromSchema && !map.contains(qint64(FieldValue::CborLabelKey));
+    field.typeFromSchema= fromSchema && !map.contains(qint64(FieldValue::CborTypeFieldKey));
+    record.fields.append(field);
+}
+} // namespace
+
+CharacterRecord CharacterRecord::fromJson(const QJsonObject& json)
+{
+    CharacterRecord record;
+    record.name= json["name"].toString();
+    record.uuid= json["idSheet"].toString();
+    auto const values= json["values"].toObject();
+    for(auto it= values.constBegin(); it != values.constEnd(); ++it)
+    {
+        auto const item= it.value().toObject();
+        auto const type= item["type"].toString();
+        if(type == QStringLiteral("field") || type == QStringLiteral("button"))
+        {
+            Field field;
+            field.value= FieldValue::fromJson(item);
+            field.value.id= it.key();
+            record.fields.append(field);
+        }
+        else if(type == QStringLiteral("TableField"))
+        {
+            auto table= TableRecord::fromJson(item);
+            table.value.id= it.key();
+            record.tables.append(table);
+        }
+    }
+    return record;
+}
+
+QJsonObject CharacterRecord::toJson() const
+{
+    QJsonObject values;
+    for(auto const& field : fields)
+    {
+        QJsonObject item;
+        field.value.toJson(item);
+        values[field.value.id]= item;
+    }
+    for(auto const& table : tables)
+    {
+        QJsonObject item;
+        table.toJson(item);
+        values[table.value.id]= item;
+    }
+
+    QJsonObject json;
+    json["name"]= name;
+    json["idSheet"]= uuid;
+    json["values"]= values;
+    return json;
+}
+
+TableRecord TableRecord::fromJson(const QJsonObject& json)
+{
+    TableRecord table;
+    table.value= FieldValue::fromJson(json);
+    table.value.type= QStringLiteral("TableField");
+
+    auto const children= json["children"].toArray();
+    table.lines.reserve(children.size());
+    for(auto const& child : children)
+    {
+        auto const cells= child.toArray();
+        QList<FieldValue> values;
+        values.reserve(cells.size());
+        for(auto const& cell : cells)
+            values.append(FieldValue::fromJson(cell.toObject()));
+        table.lines.append(values);
+    }
+
+    for(auto const& formula : json["columnFormulas"].toArray())
+    {
+        auto const obj= formula.toObject();
+        table.columnFormulas.append({obj["column"].toInt(), obj["formula"].toString()});
+    }
+    return table;
+}
+
+void TableRecord::toJson(QJsonObject& json) const
+{
+    value.toJson(json);
+
+    QJsonArray children;
+    for(auto const& line : lines)
+    {
+        QJsonArray cells;
+        for(auto const& cell : line)
+        {
+            QJsonObject obj;
+            cell.toJson(obj);
+            cells.append(obj);
+        }
+        children.append(cells);
+    }
+    json["children"]= children;
+
+    QJsonArray formulas;
+    for(auto const& formula : columnFormulas)
+        formulas.append(QJsonObject{{"column", formula.first}, {"formula", formula.second}});
+    json["columnFormulas"]= formulas;
+}
+
+CharacterRecord CharacterRecord::fromCbor(const QCborArray& array, const QStringList& keys)
+{
+    CharacterRecord record;
+    record.name= array.at(0).toString();
+    record.uuid= array.at(1).toString();
+
+    auto const values= array.at(2).toArray();
+    auto const count= std::min(values.size(), static_cast<qsizetype>(keys.size()));
+    for(qsizetype i= 0; i < count; ++i)
+        appendCborField(record, keys.at(i), values.at(i), true);
+
+    auto const extras= array.at(3).toMap();
+    for(auto it= extras.constBegin(); it != extras.constEnd(); ++it)
+        appendCborField(record, it.key().toString(), it.value(), false);
+    return record;
+}
@@ -0,0 +1,59 @@
+#ifndef CHARACTERRECORD_H
+#define CHARACTERRECORD_H
+
+#include <QCborArray>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+
+#include <charactersheet/fieldvalue.h>
+
+/**
+ * @brief The TableRecord struct holds a table field and the values of its lines, without any QObject.
+ */
+struct TableRecord
+{
+    FieldValue value; // the table field itself, its id is the key in the character
+    QList<QList<FieldValue>> lines;
+    QList<QPair<int, QString>> columnFormulas;
+
+    /**
+     * @brief fromJson reads the layout of TableField::saveDataItem.
+     */
+    static TableRecord fromJson(const QJsonObject& json);
+    void toJson(QJsonObject& json) const;
+};
+
+/**
+ * @brief The CharacterRecord struct holds the decoded data of one character, without any QObject.
+ * Records are independent from the model so they can be decoded on worker threads,
+ * CharacterSheet::load(const CharacterRecord&, const Section*) then builds the character on the owner thread.
+ */
+struct CharacterRecord
+{
+    struct Field
+    {
+        FieldValue value;
+        // binary records skip the label and the type when they match the structure.
+        bool labelFromSchema= false;
+        bool typeFromSchema= false;
+    };
+
+    QString name;
+    QString uuid;
+    QList<Field> fields;
+    QList<TableRecord> tables;
+
+    static CharacterRecord fromJson(const QJsonObject& json);
+    /**
+     * @brief toJson writes the layout read by fromJson, the one of CharacterSheet::save.
+     */
+    QJsonObject toJson() const;
+    /**
+     * @brief fromCbor reads a character written by CharacterSheet::save, keys give the field id of each position.
+     */
+    static CharacterRecord fromCbor(const QCborArray& array, const QStringList& keys);
+};
+
+#endif // CHARACTERRECORD_H
@@ -19,16 +19,38 @@
  ***************************************************************************/
 
 #include "charactersheet/charactersheet.h"
+#include <QCborMap>
+#include <QCborValue>
 #include <QDebug>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QUuid>
+#include <algorithm>
 
+#include "characterrecord.h"
 #include "charactersheet/charactersheetmodel.h"
 #include "charactersheetbutton.h"
 #include "section.h"
 #include "tablefield.h"
+
+namespace
+{
+QVariant valueFromField(const FieldValue& field, int role)
+{
+    if(role == Qt::DisplayRole)
+        return field.value;
+    else if(role == Qt::EditRole)
+        return field.formula.isEmpty() ? field.value : field.formula;
+    else if(role == Qt::ToolTipRole)
+        return field.id;
+    else if(role == CharacterSheetModel::FormulaRole)
+        return field.formula;
+    else if(role == Qt::BackgroundRole)
+        return field.readOnly;
+    return QVariant();
+}
+} // namespace
 /////////////////////////////////////////
 //          CharacterSheet           ////
 /////////////////////////////////////////
@@ -80,7 +102,7 @@ CharacterSheetItem* CharacterSheet::getFieldAt(int i) const
     if(i < m_valuesMap.size() && i >= 0)
     {
         auto const& keys= m_valuesMap.keys();
-        return m_valuesMap.value(keys.at(i));
+        return itemFromKey(keys.at(i));
     }
     return nullptr;
 }
@@ -90,19 +112,138 @@ CharacterSheetItem* CharacterSheet::getFieldFromKey(QString key) const
     QStringList keyList= key.split('.');
     if(keyList.size() > 1)
     {
-        CharacterSheetItem* field= m_valuesMap[keyList.takeFirst()];
+        CharacterSheetItem* field= itemFromKey(keyList.takeFirst());
+        if(nullptr == field)
+            return nullptr;
         field= field->getChildFromId(keyList.takeFirst());
         return field;
     }
-    else if(m_valuesMap.contains(key))
+    return itemFromKey(key);
+}
+
+CharacterSheetItem* CharacterSheet::itemFromKey(const QString& key) const
+{
+    auto it= m_valuesMap.constFind(key);
+    if(it == m_valuesMap.constEnd())
+        return nullptr;
+
+    if(nullptr != it.value())
+        return it.value();
+
+    // the item is created on demand, the sheet is logically unchanged.
+    return const_cast<CharacterSheet*>(this)->createItem(key);
+}
+
+CharacterSheetItem* CharacterSheet::createItem(const QString& key)
+{
+    auto it= m_plainValues.find(key);
+    if(it == m_plainValues.end())
+        return nullptr;
+
+    auto field= FieldController::pool().acquire();
+    it->applyTo(field);
+    m_plainValues.erase(it);
+
+    if(nullptr != m_origin)
     {
-        return m_valuesMap.value(key);
+        auto orig= m_origin->getChildFromId(key);
+        if(nullptr != orig)
+        {
+            // the structure gives how the field is drawn, the character its data.
+            field->copyPresentation(dynamic_cast<FieldController*>(orig));
+            field->setOrig(orig);
+        }
     }
-    return nullptr;
+    insertField(key, field);
+
+    // an item asked for while the sheet is not bound only serves the caller, it goes back to a value.
+    if(!isBound())
+        scheduleRelease();
+    return field;
+}
+
+bool CharacterSheet::hasField(const QString& key) const
+{
+    return m_valuesMap.contains(key);
+}
+
+QStringList CharacterSheet::fieldKeys() const
+{
+    return m_valuesMap.keys();
+}
+
+void CharacterSheet::acquireItems()
+{
+    ++m_bindCount;
+    auto const& keys= m_plainValues.keys();
+    for(auto const& key : keys)
+    {
+        createItem(key);
+    }
+}
+
+void CharacterSheet::releaseItems()
+{
+    if(m_bindCount > 0)
+        --m_bindCount;
+
+    if(m_bindCount > 0)
+        return;
+
+    releaseFieldItems();
+}
+
+void CharacterSheet::scheduleRelease()
+{
+    if(m_releaseScheduled)
+        return;
+
+    m_releaseScheduled= true;
+    QMetaObject::invokeMethod(
+        this,
+        [this]()
+        {
+            m_releaseScheduled= false;
+            if(!isBound())
+                releaseFieldItems();
+        },
+        Qt::QueuedConnection);
+}
+
+void CharacterSheet::releaseFieldItems()
+{
+    bool released= false;
+    for(auto it= m_valuesMap.begin(); it != m_valuesMap.end(); ++it)
+    {
+        auto item= it.value();
+        if(nullptr == item || item->getItemType() != CharacterSheetItem::FieldItem)
+            continue;
+
+        m_plainValues.insert(it.key(), FieldValue::fromItem(item));
+        it.value()= nullptr;
+
+        // the item may still be referenced (QML, callers of getFieldFromKey): it is deleted, never recycled,
+        // so that guarded pointers become null instead of showing the data of another field.
+        disconnect(item, nullptr, this, nullptr);
+        item->deleteLater();
+        released= true;
+    }
+
+    if(released)
+        emit itemsReleased();
+}
+
+bool CharacterSheet::isBound() const
+{
+    return m_bindCount > 0;
 }
 
 const QVariant CharacterSheet::getValue(QString path, int role) const
 {
+    auto plain= m_plainValues.constFind(path);
+    if(plain != m_plainValues.constEnd())
+        return valueFromField(plain.value(), role);
+
     CharacterSheetItem* item= getFieldFromKey(path);
     if(nullptr != item)
     {
@@ -137,6 +278,8 @@ const QVariant CharacterSheet::getValue(QString path, int role) const
 
 bool CharacterSheet::removeField(const QString& id)
 {
+    m_saveCacheValid= false;
+    m_plainValues.remove(id);
     return m_valuesMap.remove(id);
 }
 
@@ -175,6 +318,7 @@ CharacterSheetItem* CharacterSheet::setValue(QString key, QString value, QString
 {
     CharacterSheetItem* result= nullptr;
 
+    // edition goes through the item to notify the change.
     auto item= getFieldFromKey(key);
 
     if(item != nullptr)
@@ -196,9 +340,16 @@ CharacterSheetItem* CharacterSheet::setValue(QString key, QString value, QString
 QList<QString> CharacterSheet::getAllDependancy(QString key)
 {
     QList<QString> list;
-    auto const& values= m_valuesMap.values();
-    for(auto& field : values)
+    for(auto it= m_valuesMap.cbegin(); it != m_valuesMap.cend(); ++it)
     {
+        auto field= it.value();
+        if(nullptr == field)
+        {
+            auto const& plain= m_plainValues[it.key()];
+            if(!plain.formula.isEmpty() && plain.formula.contains(key))
+                list << it.key();
+            continue;
+        }
         if(field->hasFormula())
         {
             if(field->getFormula().contains(key))
@@ -262,7 +413,15 @@ void CharacterSheet::setName(const QString& name)
 
 void CharacterSheet::setFieldData(const QJsonObject& obj, const QString& parent)
 {
+    m_saveCacheValid= false;
     QString id= obj["id"].toString();
+    auto plain= m_plainValues.find(id);
+    if(plain != m_plainValues.end())
+    {
+        *plain= FieldValue::fromJson(obj);
+        return;
+    }
+
     CharacterSheetItem* value= m_valuesMap.value(id);
     if(nullptr != value)
     {
@@ -270,7 +429,7 @@ void CharacterSheet::setFieldData(const QJsonObject& obj, const QString& parent)
     }
     else
     {
-        auto item= m_valuesMap[parent];
+        auto item= m_valuesMap.value(parent);
         if(nullptr == item)
             return;
         auto table= dynamic_cast<TableField*>(item);
@@ -289,54 +448,176 @@ Section* CharacterSheet::getRootSection() const
 
 void CharacterSheet::buildDataFromSection(Section* rootSection)
 {
+    if(nullptr == m_origin)
+        m_origin= rootSection;
     rootSection->buildDataInto(this);
 }
 void CharacterSheet::save(QJsonObject& json) const
 {
     json["name"]= m_name;
     json["idSheet"]= m_uuid;
-    QJsonObject array= QJsonObject();
-    auto const& keys= m_valuesMap.keys();
-    for(const QString& key : keys)
+    if(!m_saveCacheValid)
     {
-        QJsonObject item;
-        m_valuesMap[key]->saveDataItem(item);
-        array[key]= item;
+        QJsonObject array;
+        for(auto it= m_valuesMap.constBegin(); it != m_valuesMap.constEnd(); ++it)
+        {
+            QJsonObject item;
+            auto field= it.value();
+            if(nullptr == field)
+                m_plainValues.value(it.key()).toJson(item);
+            else
+                field->saveDataItem(item);
+            array[it.key()]= item;
+        }
+        m_savedValues= array;
+        m_saveCacheValid= true;
     }
-    json["values"]= array;
+    json["values"]= m_savedValues;
 }
 
 void CharacterSheet::load(const QJsonObject& json)
 {
-    setName(json["name"].toString());
-    setUuid(json["idSheet"].toString());
-    QJsonObject array= json["values"].toObject();
-    for(auto& key : array.keys())
+    load(CharacterRecord::fromJson(json), nullptr);
+}
+
+CharacterRecord CharacterSheet::snapshot() const
+{
+    CharacterRecord record;
+    record.name= m_name;
+    record.uuid= m_uuid;
+    record.fields.reserve(m_valuesMap.size());
+    for(auto it= m_valuesMap.constBegin(); it != m_valuesMap.constEnd(); ++it)
     {
-        QJsonObject item= array[key].toObject();
-        CharacterSheetItem* itemSheet= nullptr;
-        if((item["type"] == QStringLiteral("field")) || (item["type"] == QStringLiteral("button")))
-        {
-            itemSheet= new FieldController();
-        }
-        else if(item["type"] == QStringLiteral("TableField"))
+        auto item= it.value();
+        if(auto table= dynamic_cast<TableField*>(item))
         {
-            auto table= new TableField();
-            itemSheet= table;
-            connect(table, &TableField::lineMustBeAdded, this,
-                    [this](TableField* field) { emit addLineToTableField(this, field); });
+            // cells are copied as values, the json is written by the workers.
+            auto tableRecord= table->record();
+            tableRecord.value.id= it.key();
+            record.tables.append(tableRecord);
+            continue;
         }
 
-        if(nullptr != itemSheet)
+        CharacterRecord::Field field;
+        field.value= nullptr == item ? m_plainValues.value(it.key()) : FieldValue::fromItem(item);
+        field.value.id= it.key();
+        record.fields.append(field);
+    }
+    return record;
+}
+
+bool CharacterSheet::isSaveCached() const
+{
+    return m_saveCacheValid;
+}
+
+void CharacterSheet::setSaveCache(const QJsonObject& json) const
+{
+    m_savedValues= json["values"].toObject();
+    m_saveCacheValid= true;
+}
+
+void CharacterSheet::load(const CharacterRecord& record, const Section* schema)
+{
+    setName(record.name);
+    setUuid(record.uuid);
+    for(auto const& field : record.fields)
+    {
+        auto value= field.value;
+        auto schemaItem= (nullptr != schema && (field.labelFromSchema || field.typeFromSchema)) ?
+                             schema->getChildFromId(value.id) :
+                             nullptr;
+        if(nullptr != schemaItem)
         {
-            itemSheet->loadDataItem(item);
-            itemSheet->setId(key);
-            insertField(key, itemSheet);
+            if(field.labelFromSchema)
+                value.label= schemaItem->getLabel();
+            if(field.typeFromSchema)
+                value.typeField= schemaItem->getFieldType();
         }
+        insertFieldValue(value);
+    }
+    for(auto const& table : record.tables)
+        insertTable(table);
+}
+
+void CharacterSheet::save(QCborStreamWriter& writer, const Section* schema) const
+{
+    writer.startArray(4);
+    writer.append(m_name);
+    writer.append(m_uuid);
+
+    int const count= nullptr != schema ? schema->getChildrenCount() : 0;
+    writer.startArray(static_cast<quint64>(count));
+    for(int i= 0; i < count; ++i)
+    {
+        auto schemaItem= schema->getChildAt(i);
+        writeCborField(writer, schemaItem->getId(), schemaItem);
+    }
+    writer.endArray();
+
+    writer.startMap();
+    for(auto it= m_valuesMap.constBegin(); it != m_valuesMap.constEnd(); ++it)
+    {
+        if(nullptr != schema && nullptr != schema->getChildFromId(it.key()))
+            continue;
+        writer.append(it.key());
+        writeCborField(writer, it.key(), nullptr);
+    }
+    writer.endMap();
+    writer.endArray();
+}
+
+void CharacterSheet::load(const QCborArray& array, const QStringList& keys, const Section* schema)
+{
+    load(CharacterRecord::fromCbor(array, keys), schema);
+}
+
+void CharacterSheet::insertTable(const TableRecord& record)
+{
+    auto table= new TableField();
+    connect(table, &TableField::lineMustBeAdded, this,
+            [this](TableField* field) { emit addLineToTableField(this, field); });
+    // lines have been decoded with the record, possibly on a worker thread.
+    table->loadRecord(record);
+    insertField(record.value.id, table);
+}
+
+void CharacterSheet::writeCborField(QCborStreamWriter& writer, const QString& key,
+                                    const CharacterSheetItem* schemaItem) const
+{
+    auto it= m_valuesMap.constFind(key);
+    if(it == m_valuesMap.constEnd())
+    {
+        writer.append(nullptr);
+        return;
+    }
+
+    auto field= it.value();
+    if(nullptr == field)
+    {
+        m_plainValues.value(key).toCbor(writer, schemaItem);
+    }
+    else if(field->getItemType() == CharacterSheetItem::TableItem)
+    {
+        // lines of tables keep their json layout.
+        QJsonObject json;
+        field->saveDataItem(json);
+        writer.startMap(2);
+        writer.append(qint64(FieldValue::CborTypeKey));
+        writer.append(QStringLiteral("TableField"));
+        writer.append(qint64(FieldValue::CborTableKey));
+        QCborValue::fromJsonValue(json).toCbor(writer);
+        writer.endMap();
+    }
+    else
+    {
+        FieldValue::fromItem(field).toCbor(writer, schemaItem);
     }
 }
+
 void CharacterSheet::setOrigin(Section* sec)
 {
+    m_origin= sec;
     auto const& keys= m_valuesMap.keys();
     for(auto& key : keys)
     {
@@ -356,6 +637,32 @@ void CharacterSheet::insertField(QString key, CharacterSheetItem* itemSheet)
 {
     m_valuesMap.insert(key, itemSheet);
 
+    if(auto table= dynamic_cast<TableField*>(itemSheet))
+    {
+        auto model= table->getModel();
+        auto notify= [this, table]()
+        {
+            m_saveCacheValid= false;
+            emit tableLinesChanged(this, table);
+        };
+        // rows of unfetched lines are only inserted when the view asks for them, the line count tells every change.
+        connect(model, &LineModel::lineCountChanged, this, notify);
+        connect(model, &LineModel::modelReset, this, notify);
+        connect(model, &LineModel::contentChanged, this, [this]() { m_saveCacheValid= false; });
+        connect(model, &LineModel::linesCompacted, this, [this, table]() { emit tableCellsReleased(this, table); });
+        connect(model, &LineModel::dataChanged, this,
+                [this, table](const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles)
+                {
+                    // compacted lines are given again to the view with their item roles, their values are the same.
+                    if(roles.contains(LineModel::LineRole))
+                        return;
+                    emit tableCellsChanged(this, table, topLeft.row(), bottomRight.row());
+                });
+    }
+
+    m_saveCacheValid= false;
+    // values changed from network do not emit characterSheetItemChanged, every saved data emits dataItemChanged.
+    connect(itemSheet, &CharacterSheetItem::dataItemChanged, this, [this]() { m_saveCacheValid= false; });
     connect(itemSheet, &CharacterSheetItem::characterSheetItemChanged, this,
             [=](CharacterSheetItem* item)
             {
@@ -374,9 +681,16 @@ QHash<QString, QString> CharacterSheet::getVariableDictionnary()
     auto const& keys= m_valuesMap.keys();
     for(const QString& key : keys)
     {
-        if(nullptr != m_valuesMap[key])
+        auto field= m_valuesMap[key];
+        if(nullptr != field)
         {
-            m_valuesMap[key]->setFieldInDictionnary(dataDict);
+            field->setFieldInDictionnary(dataDict);
+        }
+        else
+        {
+            auto const& plain= m_plainValues[key];
+            dataDict[plain.id]= plain.value;
+            dataDict[plain.label]= plain.value;
         }
     }
     return dataDict;
@@ -386,5 +700,56 @@ void CharacterSheet::insertCharacterItem(CharacterSheetItem* item)
 {
     if(nullptr == item)
         return;
+    m_plainValues.remove(item->getId());
     insertField(item->getId(), item);
 }
+
+void CharacterSheet::insertFieldValue(const FieldValue& value)
+{
+    m_saveCacheValid= false;
+    auto item= m_valuesMap.value(value.id);
+    if(nullptr != item)
+    {
+        value.applyTo(item);
+        return;
+    }
+    m_plainValues.insert(value.id, value);
+    m_valuesMap.insert(value.id, nullptr);
+}
+
+void CharacterSheet::updateFieldSchema(const CharacterSheetItem* schema)
+{
+    if(nullptr == schema)
+        return;
+
+    m_saveCacheValid= false;
+    auto id= schema->getId();
+    auto plain= m_plainValues.find(id);
+    if(plain != m_plainValues.end())
+    {
+        plain->typeField= schema->getFieldType();
+        plain->label= schema->getLabel();
+        return;
+    }
+
+    auto item= m_valuesMap.value(id);
+    if(nullptr == item)
+        return;
+    if(item->getFieldType() != schema->getFieldType())
+        item->setCurrentType(schema->getFieldType());
+    if(item->getLabel() != schema->getLabel())
+        item->setLabel(schema->getLabel());
+}
+
+FieldValue CharacterSheet::fieldValue(const QString& key) const
+{
+    auto plain= m_plainValues.constFind(key);
+    if(plain != m_plainValues.constEnd())
+        return plain.value();
+    return FieldValue::fromItem(m_valuesMap.value(key));
+}
+
+CharacterSheetItem* CharacterSheet::existingItem(const QString& key) const
+{
+    return m_valuesMap.value(key);
+}
@@ -58,6 +58,7 @@ void CharacterSheetItem::setReadOnly(bool readOnly)
     {
         m_readOnly= readOnly;
         emit readOnlyChanged();
+        emit dataItemChanged();
         emit characterSheetItemChanged(this);
     }
 }
@@ -83,7 +84,11 @@ QString CharacterSheetItem::getFormula() const
 
 void CharacterSheetItem::setFormula(const QString& formula)
 {
+    if(m_formula == formula)
+        return;
     m_formula= formula;
+    emit formulaChanged();
+    emit dataItemChanged();
 }
 
 CharacterSheetItem* CharacterSheetItem::getOrig() const
@@ -165,6 +170,7 @@ void CharacterSheetItem::setValue(const QString& value, bool fromNetwork)
     {
         m_value= value;
         emit valueChanged();
+        emit dataItemChanged();
         if(!fromNetwork)
         {
             emit characterSheetItemChanged(this);
@@ -188,11 +194,16 @@ void CharacterSheetItem::setLabel(const QString& label)
     {
         m_label= label;
         emit labelChanged();
+        emit dataItemChanged();
     }
 }
 void CharacterSheetItem::setId(const QString& id)
 {
+    if(m_id == id)
+        return;
     m_id= id;
+    emit idChanged();
+    emit dataItemChanged();
 }
 
 bool CharacterSheetItem::removeChild(CharacterSheetItem*)
@@ -257,11 +268,15 @@ CharacterSheetItem::TypeField CharacterSheetItem::getFieldType() const
 
 void CharacterSheetItem::setCurrentType(const CharacterSheetItem::TypeField& currentType)
 {
+    auto changed= m_currentType != currentType;
     m_currentType= currentType;
-    if(m_currentType == CharacterSheetItem::FUNCBUTTON && m_hasDefaultValue)
+    if(m_currentType == CharacterSheetItem::FUNCBUTTON && m_hasDefaultValue && !m_value.isEmpty())
     {
         m_value= "";
+        changed= true;
     }
+    if(changed)
+        emit dataItemChanged();
 }
 
 void CharacterSheetItem::setFieldInDictionnary(QHash<QString, QString>& dict) const
@@ -20,22 +20,102 @@
 
 #include "charactersheet/charactersheetmodel.h"
 #include "charactersheet/charactersheet.h"
+#include "characterrecord.h"
+#include "characterstore.h"
 #include "field.h"
 
 #include "section.h"
+#include "sectiondiff.h"
 #include "tablefield.h"
 #ifndef RCSE
 //#include "network/networkmessagereader.h"
 #endif
 
 #include <QDebug>
-
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QFutureWatcher>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QPointer>
+#include <QPromise>
+#include <QtConcurrent>
 
 #include <charactersheet/formula/formulamanager.h>
 
+namespace
+{
+// integer keys of the binary model.
+enum ModelKey
+{
+    VersionKey= 0,
+    DataKey,
+    SchemaKey,
+    CharactersKey
+};
+constexpr qint64 cborVersion= 1;
+// binary characters decoded on worker threads at once, it bounds the memory used by the decoded trees.
+constexpr int cborBatchSize= 256;
+// characters built before the first paint when the model is filled progressively.
+constexpr int firstScreenCharacterCount= 16;
+
+// one character to write, only one of the three forms is used.
+struct CharacterJob
+{
+    CharacterSheet* sheet= nullptr;
+    QJsonObject json;       // unchanged since last save
+    QByteArray pending;     // not built yet
+    CharacterRecord record; // snapshot of a changed character
+    bool snapshot= false;
+};
+
+QJsonObject serializeCharacter(const CharacterJob& job)
+{
+    if(job.snapshot)
+        return job.record.toJson();
+    if(!job.pending.isEmpty())
+        return QJsonDocument::fromJson(job.pending).object();
+    return job.json;
+}
+
+QList<QJsonObject> characterObjects(const QJsonArray& characters)
+{
+    QList<QJsonObject> objects;
+    objects.reserve(characters.size());
+    for(auto const& character : characters)
+        objects.append(character.toObject());
+    return objects;
+}
+
+// uuid of a character kept as json, read without parsing the whole character.
+QString sheetIdOf(const QByteArray& json)
+{
+    static const QByteArray key("\"idSheet\"");
+    auto const pos= json.indexOf(key);
+    auto const colon= pos < 0 ? -1 : json.indexOf(':', pos + key.size());
+    auto const begin= colon < 0 ? -1 : json.indexOf('"', colon);
+    auto const end= begin < 0 ? -1 : json.indexOf('"', begin + 1);
+    if(end < 0)
+        return {};
+    return QString::fromUtf8(json.mid(begin + 1, end - begin - 1));
+}
+
+QList<FieldSchema> schemaOf(Section* section)
+{
+    QList<FieldSchema> structure;
+    structure.reserve(section->getChildrenCount());
+    for(int i= 0; i < section->getChildrenCount(); ++i)
+        structure.append(FieldSchema::fromItem(section->getChildAt(i)));
+    return structure;
+}
+} // namespace
+
 /////////////////////////////
 /// CharacterSheetModel
 /////////////////////////////
@@ -60,13 +140,33 @@
 
 CharacterSheetModel::CharacterSheetModel() : m_formulaManager(nullptr) // m_characterCount(0),
 {
-    m_characterList= new QList<CharacterSheet*>;
+    m_characterList= new CharacterStore([this](const QByteArray& json) { return materializeCharacter(json); });
+    m_characterList->setEvictor([this](CharacterSheet* sheet) { return canReleaseCharacter(sheet); },
+                                [this](CharacterSheet* sheet) { releaseCharacter(sheet); });
     m_rootSection= new Section();
     m_formulaManager= new Formula::FormulaManager();
+
+    // cached cells are no longer valid once the structure has changed.
+    auto invalidate= [this]() { invalidateCellCache(); };
+    auto invalidateChildCounts= [this]() { m_tableChildCounts.clear(); };
+    connect(this, &CharacterSheetModel::modelAboutToBeReset, this, invalidateChildCounts);
+    connect(this, &CharacterSheetModel::columnsInserted, this, invalidateChildCounts);
+    connect(this, &CharacterSheetModel::columnsRemoved, this, invalidateChildCounts);
+    connect(this, &CharacterSheetModel::modelAboutToBeReset, this, invalidate);
+    connect(this, &CharacterSheetModel::rowsInserted, this, invalidate);
+    connect(this, &CharacterSheetModel::rowsRemoved, this, invalidate);
+    connect(this, &CharacterSheetModel::rowsMoved, this, invalidate);
+    connect(this, &CharacterSheetModel::columnsInserted, this, invalidate);
+    connect(this, &CharacterSheetModel::columnsRemoved, this, invalidate);
+
+    // changed cells are sent once per event loop iteration, or before the model moves or removes rows and columns.
+    m_changeTimer.setSingleShot(true);
+    m_changeTimer.setInterval(0);
+    connect(&m_changeTimer, &QTimer::timeout, this, &CharacterSheetModel::emitPendingChanges);
+    connect(this, &CharacterSheetModel::modelAboutToBeReset, this, [this]() { m_changedCells.clear(); });
 }
 CharacterSheetModel::~CharacterSheetModel()
 {
-    qDeleteAll(*m_characterList);
     delete m_characterList;
     delete m_rootSection;
     delete m_formulaManager;
@@ -80,16 +180,7 @@ int CharacterSheetModel::rowCount(const QModelIndex& parent) const
         CharacterSheetItem* tmp= static_cast<CharacterSheetItem*>(parent.internalPointer());
         if(tmp->getFieldType() == FieldController::TABLE && !m_characterList->isEmpty())
         {
-            int max= tmp->getChildrenCount();
-            auto result= std::max_element(m_characterList->begin(), m_characterList->end(),
-                                          [tmp](CharacterSheet* a, CharacterSheet* b)
-                                          {
-                                              auto fieldA= a->getFieldFromKey(tmp->getId());
-                                              auto fieldB= b->getFieldFromKey(tmp->getId());
-                                              return fieldA->getChildrenCount() < fieldB->getChildrenCount();
-                                          });
-            auto maxfield= (*result)->getFieldFromKey(tmp->getId());
-            val= std::max(max, maxfield->getChildrenCount());
+            val= std::max(tmp->getChildrenCount(), maxTableChildCount(tmp->getId()));
         }
         else if(tmp)
             val= tmp->getChildrenCount();
@@ -106,7 +197,9 @@ CharacterSheet* CharacterSheetModel::getCharacterSheet(int id)
 {
     if((!m_characterList->isEmpty()) && (m_characterList->size() > id) && (0 <= id))
     {
-        return m_characterList->at(id);
+        auto sheet= m_characterList->at(id);
+        handOut(sheet);
+        return sheet;
     }
     return nullptr;
 }
@@ -142,11 +235,12 @@ QModelIndex CharacterSheetModel::index(int row, int column, const QModelIndex& p
     if(structureItem == nullptr)
         return {};
 
+    // Character cells are pointed by their structure item, the character field may have no item yet.
     if(column != 0 && !parent.isValid())
     {
-        auto path= structureItem->getPath();
         auto sheet= m_characterList->at(column - 1);
-        childItem= sheet->getFieldFromKey(path);
+        if(sheet->hasField(pathOf(structureItem)))
+            childItem= structureItem;
     }
     else
     {
@@ -190,84 +284,128 @@ QVariant CharacterSheetModel::data(const QModelIndex& index, int role) const
     if((role == Qt::TextAlignmentRole) && (index.column() != 0))
         return Qt::AlignHCenter;
 
+    if(!isCellRole(role))
+        return QVariant();
+
+    return cellData(resolveCell(index), role);
+}
+
+void CharacterSheetModel::multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const
+{
+    for(auto& roleData : roleDataSpan)
+        roleData.clearData();
+
+    if(!index.isValid())
+        return;
+
+    // the cell is resolved once for all the roles.
+    CellContext cell;
+    bool resolved= false;
+    for(auto& roleData : roleDataSpan)
+    {
+        auto const role= roleData.role();
+        if((role == Qt::TextAlignmentRole) && (index.column() != 0))
+        {
+            roleData.setData(Qt::AlignHCenter);
+            continue;
+        }
+        if(!isCellRole(role))
+            continue;
+        if(!resolved)
+        {
+            cell= resolveCell(index);
+            resolved= true;
+        }
+        roleData.setData(cellData(cell, role));
+    }
+}
+
+bool CharacterSheetModel::isCellRole(int role)
+{
+    return (role == Qt::DisplayRole) || (role == Qt::EditRole) || (role == Qt::BackgroundRole)
+           || (role == Qt::ToolTipRole) || (role == Qt::UserRole) || (role == FormulaRole) || (role == ValueRole)
+           || (role == UuidRole) || (role == NameRole);
+}
+
+CharacterSheetModel::CellContext CharacterSheetModel::resolveCell(const QModelIndex& index) const
+{
+    CellContext cell;
+    cell.item= static_cast<CharacterSheetItem*>(index.internalPointer());
+    cell.column= index.column();
+    if(nullptr == cell.item || cell.column == 0)
+        return cell;
+
+    cell.sheet= m_characterList->at(cell.column - 1);
+    cell.path= pathOf(cell.item);
+    auto parentItem= cell.item->getParent();
+    if(parentItem && parentItem->getFieldType() == FieldController::TABLE)
+    {
+        cell.inTable= true;
+        cell.tableCell= tableCell(cell.item, index.row(), cell.sheet);
+    }
+    return cell;
+}
+
+QVariant CharacterSheetModel::cellData(const CellContext& cell, int role) const
+{
     QVariant var;
-    if((role == Qt::DisplayRole) || (role == Qt::EditRole) || (role == Qt::BackgroundRole) || (role == Qt::ToolTipRole)
-       || (role == Qt::UserRole) || (role == FormulaRole) || (role == ValueRole) || (role == UuidRole)
-       || (role == NameRole))
+    if(nullptr == cell.item)
+        return var;
+
+    if(role == Qt::BackgroundRole)
     {
-        CharacterSheetItem* childItem= static_cast<CharacterSheetItem*>(index.internalPointer());
-        if(nullptr != childItem)
+        if(0 != cell.column)
         {
-            CharacterSheetItem* parentItem= childItem->getParent();
-            if(role == Qt::BackgroundRole)
+            bool isReadOnly= cell.sheet->getValue(cell.path, Qt::BackgroundRole).toBool();
+            if(isReadOnly)
             {
-                if(0 != index.column())
-                {
-                    QString path= childItem->getPath();
-                    CharacterSheet* sheet= m_characterList->at(index.column() - 1);
-                    bool isReadOnly= sheet->getValue(path, Qt::BackgroundRole).toBool();
-                    if(isReadOnly)
-                    {
-                        var= QColor(128, 128, 128);
-                    }
-                }
+                var= QColor(128, 128, 128);
             }
-            else
+        }
+    }
+    else if(cell.column == 0)
+    {
+        var= cell.item->getLabel();
+    }
+    else if(cell.inTable)
+    {
+        auto child= cell.tableCell;
+        if(child != nullptr)
+        {
+            switch(role)
             {
-                if(index.column() == 0)
-                {
-                    var= childItem->getLabel();
-                }
-                else
-                {
-                    if(parentItem && parentItem->getFieldType() == FieldController::TABLE)
-                    {
-                        QString path= parentItem->getPath();
-                        CharacterSheet* sheet= m_characterList->at(index.column() - 1);
-                        auto table= sheet->getFieldFromKey(path);
-                        auto child= table->getChildAt(index.row());
-                        if(child != nullptr)
-                        {
-                            switch(role)
-                            {
-                            case Qt::DisplayRole:
-                                var= child->value();
-                                break;
-                            case Qt::EditRole:
-                            {
-                                auto val= child->getFormula();
-                                if(val.isEmpty())
-                                    val= child->value();
-                                var= val;
-                            }
-                            break;
-                            case UuidRole:
-                                var= sheet->uuid();
-                                break;
-                            case NameRole:
-                                var= sheet->name();
-                                break;
-                            case Qt::ToolTipRole:
-                                var= child->getId();
-                                break;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        QString path= childItem->getPath();
-                        CharacterSheet* sheet= m_characterList->at(index.column() - 1);
-                        if(role == UuidRole)
-                            var= sheet->uuid();
-                        else if(role == NameRole)
-                            var= sheet->name();
-                        else
-                            var= sheet->getValue(path, static_cast<Qt::ItemDataRole>(role));
-                    }
-                }
+            case Qt::DisplayRole:
+                var= child->value();
+                break;
+            case Qt::EditRole:
+            {
+                auto val= child->getFormula();
+                if(val.isEmpty())
+                    val= child->value();
+                var= val;
+            }
+            break;
+            case UuidRole:
+                var= cell.sheet->uuid();
+                break;
+            case NameRole:
+                var= cell.sheet->name();
+                break;
+            case Qt::ToolTipRole:
+                var= child->getId();
+                break;
             }
         }
     }
+    else
+    {
+        if(role == UuidRole)
+            var= cell.sheet->uuid();
+        else if(role == NameRole)
+            var= cell.sheet->name();
+        else
+            var= cell.sheet->getValue(cell.path, static_cast<Qt::ItemDataRole>(role));
+    }
     return var;
 }
 
@@ -283,6 +421,7 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
             {
                 emit dataCharacterChange();
                 childItem->setLabel(value.toString());
+                markChanged(childItem->getParent(), index.row(), 0, labelRoles());
             }
             else
             {
@@ -291,12 +430,12 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
                 auto valueStr= value.toString();
                 if(parentItem && parentItem->getFieldType() == FieldController::TABLE)
                 {
-                    QString path= parentItem->getPath();
                     CharacterSheet* sheet= m_characterList->at(index.column() - 1);
-                    auto table= sheet->getFieldFromKey(path);
-                    auto child= table->getChildAt(index.row());
+                    auto child= tableCell(childItem, index.row(), sheet);
                     if(nullptr == child)
                         return false;
+                    auto const previousValue= child->value();
+                    auto const previousFormula= child->getFormula();
                     if(valueStr.startsWith('='))
                     {
                         formula= valueStr;
@@ -306,6 +445,7 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
                         child->setFormula(formula);
                     }
                     child->setValue(valueStr);
+                    notifyFormulaOnlyEdit(sheet, child, previousValue, previousFormula);
                 }
                 else
                 {
@@ -319,7 +459,12 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
                         valueStr= m_formulaManager->getValue(formula).toString();
                     }
 
+                    auto item= sheet->getFieldFromKey(path);
+                    auto const previousValue= nullptr != item ? item->value() : QString();
+                    auto const previousFormula= nullptr != item ? item->getFormula() : QString();
                     CharacterSheetItem* newitem= sheet->setValue(path, valueStr, formula);
+                    if(nullptr != item)
+                        notifyFormulaOnlyEdit(sheet, item, previousValue, previousFormula);
                     if(nullptr != newitem)
                     {
                         newitem->setLabel(childItem->getLabel());
@@ -327,6 +472,9 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
                     }
                     computeFormula(childItem->getLabel(), sheet);
                 }
+                m_characterList->markModified(m_characterList->at(index.column() - 1));
+                markChanged(static_cast<CharacterSheetItem*>(index.parent().internalPointer()), index.row(),
+                            index.column(), valueRoles());
                 emit dataCharacterChange();
             }
             return true;
@@ -334,6 +482,20 @@ bool CharacterSheetModel::setData(const QModelIndex& index, const QVariant& valu
     }
     return false;
 }
+void CharacterSheetModel::notifyFormulaOnlyEdit(CharacterSheet* sheet, CharacterSheetItem* item,
+                                                const QString& previousValue, const QString& previousFormula)
+{
+    // a changed value is notified by the item, a formula giving the same value is not.
+    if(item->value() != previousValue || item->getFormula() == previousFormula)
+        return;
+
+    QString path;
+    auto parent= item->getParent();
+    if(nullptr != parent)
+        path= parent->getPath();
+    emit fieldChanged(sheet, item, path);
+}
+
 void CharacterSheetModel::computeFormula(QString path, CharacterSheet* sheet)
 {
     QStringList List= sheet->getAllDependancy(path);
@@ -348,19 +510,141 @@ void CharacterSheetModel::computeFormula(QString path, CharacterSheet* sheet)
         formula= sheet->getValue(item, Qt::EditRole).toString();
         valueStr= m_formulaManager->getValue(formula).toString();
         sheet->setValue(item, valueStr, formula);
+        markFieldChanged(sheet, item, valueRoles());
     }
 }
-void CharacterSheetModel::fieldHasBeenChanged(CharacterSheet* sheet, CharacterSheetItem* item, const QString&)
+void CharacterSheetModel::fieldHasBeenChanged(CharacterSheet* sheet, CharacterSheetItem* item, const QString& path)
 {
+    // the read-only state may have changed as well as the value.
+    if(path.isEmpty())
+        markFieldChanged(sheet, item->getId(), fieldRoles());
+    else
+        markTableCellChanged(sheet, path, item, fieldRoles());
     emit dataCharacterChange();
     computeFormula(item->getLabel(), sheet);
 }
 
+const QList<int>& CharacterSheetModel::labelRoles()
+{
+    static const QList<int> roles{Qt::DisplayRole, Qt::EditRole};
+    return roles;
+}
+
+const QList<int>& CharacterSheetModel::valueRoles()
+{
+    static const QList<int> roles{Qt::DisplayRole, Qt::EditRole, ValueRole, FormulaRole};
+    return roles;
+}
+
+const QList<int>& CharacterSheetModel::fieldRoles()
+{
+    static const QList<int> roles{Qt::DisplayRole, Qt::EditRole, ValueRole, FormulaRole, Qt::BackgroundRole};
+    return roles;
+}
+
+void CharacterSheetModel::markChanged(CharacterSheetItem* parent, int row, int column, const QList<int>& roles)
+{
+    if(row < 0 || column < 0)
+        return;
+
+    if(parent == m_rootSection)
+        parent= nullptr;
+    auto& changed= m_changedCells[qMakePair(parent, column)][row];
+    for(auto role : roles)
+    {
+        if(!changed.contains(role))
+            changed.append(role);
+    }
+    if(!m_changeTimer.isActive())
+        m_changeTimer.start();
+}
+
+void CharacterSheetModel::markFieldChanged(CharacterSheet* sheet, const QString& path, const QList<int>& roles)
+{
+    auto item= m_rootSection->getChildFromId(path);
+    if(nullptr == item)
+        return;
+    markChanged(item->getParent(), item->rowInParent(), m_characterList->indexOf(sheet) + 1, roles);
+}
+
+void CharacterSheetModel::markTableCellChanged(CharacterSheet* sheet, const QString& tablePath,
+                                               CharacterSheetItem* cell, const QList<int>& roles)
+{
+    auto structTable= m_rootSection->getChildFromId(tablePath);
+    auto table= sheet->getFieldFromKey(tablePath);
+    if(nullptr == structTable || nullptr == table)
+        return;
+    markChanged(structTable, table->indexOfChild(cell), m_characterList->indexOf(sheet) + 1, roles);
+}
+
+void CharacterSheetModel::markTableLinesChanged(CharacterSheet* sheet, CharacterSheetItem* table, int firstLine,
+                                                int lastLine)
+{
+    auto structTable= dynamic_cast<TableField*>(m_rootSection->getChildFromId(table->getPath()));
+    if(nullptr == structTable || firstLine > lastLine)
+        return;
+
+    auto const column= m_characterList->indexOf(sheet) + 1;
+    auto const perLine= structTable->itemPerLine();
+    auto const last= std::min((lastLine + 1) * perLine, structTable->getChildrenCount()) - 1;
+    for(int row= firstLine * perLine; row <= last; ++row)
+        markChanged(structTable, row, column, valueRoles());
+}
+
+void CharacterSheetModel::emitPendingChanges()
+{
+    m_changeTimer.stop();
+    auto changes= m_changedCells;
+    m_changedCells.clear();
+    for(auto it= changes.constBegin(); it != changes.constEnd(); ++it)
+    {
+        auto parentItem= it.key().first;
+        auto const column= it.key().second;
+        QModelIndex parent;
+        if(nullptr != parentItem)
+            parent= createIndex(parentItem->rowInParent(), 0, parentItem);
+        auto const rowTotal= rowCount(parent);
+
+        // consecutive rows with the same roles are sent as one range.
+        int first= -1;
+        int last= -1;
+        QList<int> roles;
+        auto flush= [&]()
+        {
+            if(first < 0)
+                return;
+            auto topLeft= index(first, column, parent);
+            auto bottomRight= index(last, column, parent);
+            if(topLeft.isValid() && bottomRight.isValid())
+                emit dataChanged(topLeft, bottomRight, roles);
+        };
+        auto const& rows= it.value();
+        for(auto row= rows.constBegin(); row != rows.constEnd(); ++row)
+        {
+            if(row.key() >= rowTotal)
+                break;
+            if(first >= 0 && row.key() == last + 1 && row.value() == roles)
+            {
+                last= row.key();
+                continue;
+            }
+            flush();
+            first= last= row.key();
+            roles= row.value();
+        }
+        flush();
+    }
+}
+
 void CharacterSheetModel::clearModel()
 {
+    cancelPendingLoad();
     beginResetModel();
-    qDeleteAll(*m_characterList);
     m_characterList->clear();
+    m_sheetByUuid.clear();
+    m_handedOutSheets.clear();
+    m_evictedTableChildCounts.clear();
+    m_unsyncedSheets.clear();
     if(nullptr != m_rootSection)
     {
         m_rootSection->removeAll();
@@ -370,53 +654,29 @@ void CharacterSheetModel::clearModel()
 
 void CharacterSheetModel::checkCharacter(Section* section)
 {
-    for(auto& sheet : *m_characterList)
-    {
-        for(int i= 0; i < section->getChildrenCount(); ++i)
-        {
-            auto id= section->getChildAt(i);
-            auto field= sheet->getFieldFromKey(id->getId());
-            if(nullptr == field && id->getFieldType() != CharacterSheetItem::TABLE)
-            {
-                FieldController* newField= new FieldController(false);
-                newField->copyField(id, true);
-                sheet->insertCharacterItem(newField);
-                field= newField;
-            }
-            else if(nullptr == field && id->getFieldType() == CharacterSheetItem::TABLE)
-            {
-                TableField* newtablefield= new TableField(false);
-                newtablefield->copyField(id, true);
-                sheet->insertCharacterItem(newtablefield);
-                field= newtablefield;
-            }
-            for(int j= 0; j < id->getChildrenCount(); ++j)
-            {
-                auto childFormat= id->getChildAt(j);
-                auto childCharacter= field->getChildAt(j);
-                if(nullptr != childFormat && nullptr != childCharacter)
-                {
-                    if(childFormat->getId() != childCharacter->getId())
-                    {
-                        childCharacter->setId(childFormat->getId());
-                    }
-                }
-            }
-            if(field->getFieldType() != id->getFieldType())
-            {
-                field->setCurrentType(id->getFieldType());
-            }
-            if(field->getLabel() != id->getLabel())
-            {
-                field->setLabel(id->getLabel());
-            }
-        }
-    }
+    if(nullptr == section)
+        return;
+
+    auto const structure= schemaOf(section);
+
+    // characters are only read while patches are planned, this thread waits for the workers.
+    // characters not built yet are checked when they are built.
+    auto const patches= QtConcurrent::blockingMapped<QList<CharacterPatch>>(
+        m_characterList->loadedSheets(),
+        [&structure](CharacterSheet* sheet) { return CharacterPatch::plan(sheet, structure); });
+
+    for(auto const& patch : patches)
+        patch.apply(structure, section);
+    invalidateCellCache();
+    m_tableChildCounts.clear();
 }
 void CharacterSheetModel::addCharacterSheet(CharacterSheet* sheet, int pos)
 {
+    // pending changes are given with the columns they have been recorded with.
+    emitPendingChanges();
     beginInsertColumns(QModelIndex(), pos + 1, pos + 1);
     m_characterList->insert(pos, sheet);
+    connectSheet(sheet);
     endInsertColumns();
     emit characterSheetHasBeenAdded(sheet);
     emit dataCharacterChange();
@@ -435,14 +695,24 @@ void CharacterSheetModel::addSubChildRoot(CharacterSheetItem* item)
 
     auto addedFieldCount= structTable->itemPerLine();
     auto index= createIndex(r, 0, parentItem);
-    beginInsertRows(index, parentItem->getChildrenCount(), parentItem->getChildrenCount() + addedFieldCount);
+    beginInsertRows(index, parentItem->getChildrenCount(), parentItem->getChildrenCount() + addedFieldCount - 1);
     structTable->appendChild(nullptr);
     endInsertRows();
 }
 
 void CharacterSheetModel::addSubChild(CharacterSheet* sheet, CharacterSheetItem* item)
 {
-    if(!m_rootSection)
+    auto table= dynamic_cast<TableField*>(item);
+    if(table == nullptr)
+        return;
+
+    // generic method - for tableview the item is built from the last one.
+    insertLines(sheet, item, table->lineNumber(), 1);
+}
+
+void CharacterSheetModel::insertLines(CharacterSheet* sheet, CharacterSheetItem* item, int pos, int count)
+{
+    if(!m_rootSection || count <= 0)
         return;
 
     auto c= m_characterList->indexOf(sheet) + 1;
@@ -450,29 +720,62 @@ void CharacterSheetModel::addSubChild(CharacterSheet* sheet, CharacterSheetItem*
     auto r= m_rootSection->indexOfChild(parentItem);
     auto table= dynamic_cast<TableField*>(item);
     auto structTable= dynamic_cast<TableField*>(parentItem);
-    if(table == nullptr || structTable == nullptr)
+    if(c == 0 || table == nullptr || structTable == nullptr)
         return;
 
     auto lineCount= table->lineNumber();
     auto structLineCount= structTable->lineNumber();
-    auto addedFieldCount= table->itemPerLine();
-    if(lineCount < 0 || structLineCount < 0 || addedFieldCount < 0)
+    auto fieldPerLine= table->itemPerLine();
+    if(lineCount < 0 || structLineCount < 0 || fieldPerLine < 0)
         return;
 
-    if(lineCount == structLineCount)
-    {
-        auto index= createIndex(r, 0, parentItem);
-        beginInsertRows(index, parentItem->getChildrenCount(), parentItem->getChildrenCount() + addedFieldCount);
-        structTable->appendChild(nullptr);
+    pos= qBound(0, pos, lineCount);
+    auto parentIndex= createIndex(r, 0, parentItem);
+    auto const oldRowCount= rowCount(parentIndex);
+    auto const newRowCount= std::max(oldRowCount, (lineCount + count) * fieldPerLine);
+
+    // The structure keeps as many lines as the longest character table, rows are added once for the range.
+    if(newRowCount > oldRowCount)
+        beginInsertRows(parentIndex, oldRowCount, newRowCount - 1);
+    if(structLineCount < lineCount + count)
+        structTable->insertLines(structLineCount, lineCount + count - structLineCount);
+    table->insertLines(pos, count);
+    if(newRowCount > oldRowCount)
         endInsertRows();
-    }
 
-    auto index= createIndex(r, c, item);
-    beginInsertRows(index, item->getChildrenCount(), item->getChildrenCount() + addedFieldCount);
-    // generic method - for tableview the item is built from the last one.
-    table->appendChild(nullptr);
-    checkTableItem();
-    endInsertRows();
+    // cells after pos have moved in the character column.
+    auto topLeft= index(pos * fieldPerLine, c, parentIndex);
+    auto bottomRight= index(newRowCount - 1, c, parentIndex);
+    if(topLeft.isValid() && bottomRight.isValid())
+        emit dataChanged(topLeft, bottomRight);
+}
+
+void CharacterSheetModel::removeLines(CharacterSheet* sheet, CharacterSheetItem* item, int first, int last)
+{
+    if(!m_rootSection)
+        return;
+
+    auto c= m_characterList->indexOf(sheet) + 1;
+    auto parentItem= m_rootSection->getChildFromId(item->getPath());
+    auto r= m_rootSection->indexOfChild(parentItem);
+    auto table= dynamic_cast<TableField*>(item);
+    if(c == 0 || table == nullptr || parentItem == nullptr)
+        return;
+
+    auto fieldPerLine= table->itemPerLine();
+    first= std::max(first, 0);
+    last= std::min(last, table->lineNumber() - 1);
+    if(fieldPerLine < 0 || first > last)
+        return;
+
+    // The structure keeps its lines so the row count does not change, the cells of the column are shifted.
+    table->removeLines(first, last);
+
+    auto parentIndex= createIndex(r, 0, parentItem);
+    auto topLeft= index(first * fieldPerLine, c, parentIndex);
+    auto bottomRight= index(rowCount(parentIndex) - 1, c, parentIndex);
+    if(topLeft.isValid() && bottomRight.isValid())
+        emit dataChanged(topLeft, bottomRight);
 }
 void CharacterSheetModel::removeCharacterSheet(CharacterSheet* sheet)
 {
@@ -480,9 +783,14 @@ void CharacterSheetModel::removeCharacterSheet(CharacterSheet* sheet)
 
     if(pos >= 0)
     {
+        emitPendingChanges();
         beginRemoveColumns(QModelIndex(), pos + 1, pos + 1);
 
-        m_characterList->removeAt(pos);
+        m_characterList->takeAt(pos);
+        unindexSheet(sheet);
+        m_unsyncedSheets.remove(sheet);
+        m_handedOutSheets.remove(sheet);
+        disconnect(sheet, nullptr, this, nullptr);
 
         endRemoveColumns();
     }
@@ -490,24 +798,93 @@ void CharacterSheetModel::removeCharacterSheet(CharacterSheet* sheet)
 
 void CharacterSheetModel::removeCharacterSheet(int index)
 {
+    if(index < 0 || index >= m_characterList->size())
+        return;
+
+    emitPendingChanges();
     beginRemoveColumns(QModelIndex(), index + 1, index + 1);
 
-    m_characterList->removeAt(index);
+    auto sheet= m_characterList->takeAt(index);
+    if(nullptr != sheet)
+    {
+        unindexSheet(sheet);
+        m_unsyncedSheets.remove(sheet);
+        m_handedOutSheets.remove(sheet);
+        disconnect(sheet, nullptr, this, nullptr);
+    }
 
     endRemoveColumns();
 }
 
+bool CharacterSheetModel::setFieldData(const QString& uuid, const QJsonObject& data, const QString& parent)
+{
+    auto sheet= findCharacterSheet(uuid);
+    if(nullptr == sheet)
+        return false;
+
+    sheet->setFieldData(data, parent);
+    m_characterList->markModified(sheet);
+    invalidateCellCache();
+    auto const column= m_characterList->indexOf(sheet) + 1;
+    auto const rows= rowCount();
+    if(rows > 0)
+        emit dataChanged(index(0, column), index(rows - 1, column));
+    emit dataCharacterChange();
+    return true;
+}
+
 CharacterSheet* CharacterSheetModel::getCharacterSheetById(QString id)
+{
+    auto sheet= findCharacterSheet(id);
+    handOut(sheet);
+    return sheet;
+}
+
+void CharacterSheetModel::handOut(CharacterSheet* sheet)
+{
+    if(nullptr == sheet)
+        return;
+
+    // callers use the character right away, it may be evicted again once they are done.
+    if(m_handedOutSheets.isEmpty())
+    {
+        QMetaObject::invokeMethod(
+            this,
+            [this]()
+            {
+                m_handedOutSheets.clear();
+                m_characterList->trim();
+            },
+            Qt::QueuedConnection);
+    }
+    m_handedOutSheets.insert(sheet);
+}
+
+CharacterSheet* CharacterSheetModel::findCharacterSheet(const QString& id)
 {
     if(nullptr == m_characterList)
         return nullptr;
 
-    auto it= std::find_if(m_characterList->begin(), m_characterList->end(),
-                          [id](CharacterSheet* sheet) { return sheet->uuid() == id; });
-    if(it == m_characterList->end())
-        return nullptr;
+    QUuid uuid(id);
+    if(!uuid.isNull())
+    {
+        CharacterSheet* sheet= m_sheetByUuid.value(uuid);
+        if(nullptr != sheet)
+            return sheet;
+    }
     else
-        return (*it);
+    {
+        // uuid loaded from old files may not be well formed, they are not in the index.
+        auto const sheets= m_characterList->loadedSheets();
+        auto it= std::find_if(sheets.begin(), sheets.end(),
+                              [id](CharacterSheet* sheet) { return sheet->uuid() == id; });
+        if(it != sheets.end())
+            return (*it);
+    }
+
+    // characters not built yet, or evicted, are found from the uuid kept with their data, only that one is built.
+    auto const pos= m_characterList->indexOfUnloaded(id);
+    return pos < 0 ? nullptr : m_characterList->at(pos);
 }
 
 int CharacterSheetModel::getCharacterSheetCount() const
@@ -541,16 +918,141 @@ QJsonObject CharacterSheetModel::rootSectionData() const
 void CharacterSheetModel::setRootSection(Section* rootSection)
 {
     auto previous= m_rootSection;
-    beginResetModel();
-    m_rootSection= rootSection;
-    endResetModel();
-    if(m_rootSection != previous)
-        connect(m_rootSection, &Section::addLineToTableField, this, &CharacterSheetModel::addSubChildRoot);
+    if(nullptr == previous || nullptr == rootSection || previous == rootSection)
+    {
+        // nothing to compare with, the structure may have been edited in place.
+        beginResetModel();
+        m_rootSection= rootSection;
+        endResetModel();
+        if(m_rootSection != previous && nullptr != m_rootSection)
+            connect(m_rootSection, &Section::addLineToTableField, this, &CharacterSheetModel::addSubChildRoot);
+
+        for(auto& character : m_characterList->loadedSheets())
+        {
+            character->buildDataFromSection(rootSection);
+        }
+        return;
+    }
+
+    auto diff= SectionDiff::compute(previous, rootSection);
+    mergeRootSection(rootSection);
+    connect(m_rootSection, &Section::addLineToTableField, this, &CharacterSheetModel::addSubChildRoot);
 
-    for(auto& character : *m_characterList)
+    // characters not built yet get the structure when they are built.
+    for(auto& character : m_characterList->loadedSheets())
     {
-        character->buildDataFromSection(rootSection);
+        diff.applyTo(character);
+        character->setOrigin(m_rootSection);
     }
+    invalidateCellCache();
+    m_tableChildCounts.clear();
+
+    auto rows= m_rootSection->getChildrenCount();
+    if(rows > 0)
+        emit dataChanged(index(0, 0), index(rows - 1, columnCount() - 1));
+    emit dataCharacterChange();
+}
+
+void CharacterSheetModel::mergeRootSection(Section* rootSection)
+{
+    // pending changes are given with the rows they have been recorded with.
+    emitPendingChanges();
+    auto current= m_rootSection;
+    QList<CharacterSheetItem*> discarded;
+
+    // rows of fields which are gone, or which can't be replaced in place, are removed by ranges.
+    int last= -1;
+    auto removeRange= [this, current, &discarded, &last](int first)
+    {
+        beginRemoveRows(QModelIndex(), first, last);
+        for(int i= last; i >= first; --i)
+            discarded.append(current->takeChildAt(i));
+        endRemoveRows();
+        last= -1;
+    };
+    for(int i= current->getChildrenCount() - 1; i >= 0; --i)
+    {
+        auto item= current->getChildAt(i);
+        auto match= rootSection->getChildFromId(item->getPath());
+        bool const keep= SectionDiff::sameShape(item, match);
+        if(!keep && last < 0)
+            last= i;
+        else if(keep && last >= 0)
+            removeRange(i + 1);
+    }
+    if(last >= 0)
+        removeRange(0);
+
+    // kept rows are moved to their new place and new rows are inserted, so both sections have the same keys.
+    int const count= rootSection->getChildrenCount();
+    for(int i= 0; i < count;)
+    {
+        auto item= rootSection->getChildAt(i);
+        auto key= item->getPath();
+        auto existing= current->getChildFromId(key);
+        if(nullptr != existing)
+        {
+            auto pos= current->indexOfChild(existing);
+            if(pos != i)
+            {
+                beginMoveRows(QModelIndex(), pos, pos, QModelIndex(), i);
+                current->moveChild(pos, i);
+                endMoveRows();
+            }
+            ++i;
+            continue;
+        }
+
+        int end= i + 1;
+        while(end < count && nullptr == current->getChildFromId(rootSection->getChildAt(end)->getPath()))
+            ++end;
+        beginInsertRows(QModelIndex(), i, end - 1);
+        for(int j= i; j < end; ++j)
+            current->insertChild(rootSection->getChildAt(j), j);
+        endInsertRows();
+        i= end;
+    }
+
+    // rows are identical now, the items of the new structure take the place of the old ones.
+    QHash<CharacterSheetItem*, CharacterSheetItem*> replacements;
+    std::function<void(CharacterSheetItem*, CharacterSheetItem*)> mapItems;
+    mapItems= [&replacements, &mapItems](CharacterSheetItem* from, CharacterSheetItem* to)
+    {
+        replacements.insert(from, to);
+        for(int i= 0; i < from->getChildrenCount(); ++i)
+            mapItems(from->getChildAt(i), to->getChildAt(i));
+    };
+    for(int i= 0; i < count; ++i)
+    {
+        auto from= current->getChildAt(i);
+        auto to= rootSection->getChildAt(i);
+        if(from == to)
+            continue;
+        mapItems(from, to);
+        discarded.append(from);
+    }
+
+    emit layoutAboutToBeChanged();
+    auto const persistent= persistentIndexList();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(persistent.size());
+    for(auto const& idx : persistent)
+    {
+        auto item= static_cast<CharacterSheetItem*>(idx.internalPointer());
+        auto replacement= replacements.value(item, item);
+        newIndexes.append(createIndex(idx.row(), idx.column(), replacement));
+    }
+    changePersistentIndexList(persistent, newIndexes);
+
+    m_rootSection= rootSection;
+    for(int i= 0; i < count; ++i)
+        rootSection->getChildAt(i)->setParent(rootSection);
+    // the previous section belongs to the caller, it keeps the unused items so deleting it frees them.
+    current->removeAll();
+    for(auto item : std::as_const(discarded))
+        current->appendChild(item);
+    invalidateCellCache();
+    emit layoutChanged();
 }
 
 QVariant CharacterSheetModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -591,7 +1093,18 @@ Qt::ItemFlags CharacterSheetModel::flags(const QModelIndex& index) const
 
     CharacterSheetItem* childItem= static_cast<CharacterSheetItem*>(index.internalPointer());
 
-    if(nullptr != childItem && childItem->isReadOnly())
+    bool isReadOnly= false;
+    if(nullptr != childItem && !index.parent().isValid())
+    {
+        CharacterSheet* sheet= m_characterList->at(index.column() - 1);
+        isReadOnly= sheet->getValue(pathOf(childItem), Qt::BackgroundRole).toBool();
+    }
+    else if(nullptr != childItem)
+    {
+        isReadOnly= childItem->isReadOnly();
+    }
+
+    if(isReadOnly)
         return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
     else
         return Qt::ItemIsEnabled | Qt::ItemIsEditable | Qt::ItemIsSelectable;
@@ -691,8 +1204,10 @@ QModelIndex CharacterSheetModel::indexToSectionIndex(const QModelIndex& index)
     endResetModel();
 }*/
 
-bool CharacterSheetModel::writeModel(QJsonObject& jsonObj, bool writeData)
+bool CharacterSheetModel::writeModel(QJsonObject& jsonObj, bool writeData, bool parallel)
 {
+    // characters still decoded by a progressive load would be missing.
+    finishPendingLoad();
     if(writeData)
     {
         jsonObj["data"]= rootSectionData();
@@ -700,36 +1215,590 @@ bool CharacterSheetModel::writeModel(QJsonObject& jsonObj, bool writeData)
     jsonObj["characterCount"]= m_characterList->size(); // m_characterCount;
 
     QJsonArray characters;
-    for(auto& item : *m_characterList)
+    if(parallel)
     {
+        // data are copied here, workers only see plain values and the array is assembled in order.
+        QList<CharacterJob> jobs;
+        jobs.reserve(m_characterList->size());
+        for(int i= 0; i < m_characterList->size(); ++i)
+        {
+            CharacterJob job;
+            if(!m_characterList->isLoaded(i))
+            {
+                job.pending= m_characterList->pendingData(i);
+            }
+            else
+            {
+                job.sheet= m_characterList->at(i);
+                job.snapshot= !job.sheet->isSaveCached();
+                if(job.snapshot)
+                    job.record= job.sheet->snapshot();
+                else
+                    job.sheet->save(job.json);
+            }
+            jobs.append(job);
+        }
+
+        auto const results= QtConcurrent::blockingMapped<QList<QJsonObject>>(jobs, &serializeCharacter);
+        for(int i= 0; i < results.size(); ++i)
+        {
+            auto const& job= jobs.at(i);
+            if(job.snapshot)
+                job.sheet->setSaveCache(results.at(i));
+            characters.append(results.at(i));
+        }
+        jsonObj["characters"]= characters;
+        m_characterList->markSaved();
+        return true;
+    }
+
+    for(int i= 0; i < m_characterList->size(); ++i)
+    {
+        // characters not built yet are written back from their json.
+        if(!m_characterList->isLoaded(i))
+        {
+            characters.append(QJsonDocument::fromJson(m_characterList->pendingData(i)).object());
+            continue;
+        }
         QJsonObject charObj;
-        item->save(charObj);
+        m_characterList->at(i)->save(charObj);
         characters.append(charObj);
     }
     jsonObj["characters"]= characters;
+    m_characterList->markSaved();
     return true;
 }
 
 void CharacterSheetModel::readModel(const QJsonObject& jsonObj, bool readRootSection)
 {
-    beginResetModel();
+    // characters are independent: they are decoded in parallel, only QObjects are built on this thread.
+    auto const records= QtConcurrent::blockingMapped<QList<CharacterRecord>>(
+        characterObjects(jsonObj["characters"].toArray()), &CharacterRecord::fromJson);
+
+    beginLoading();
+    if(readRootSection)
+        loadRootSection(jsonObj["data"].toObject());
+    loadRecords(records);
+    endLoading();
+}
+
+QFuture<void> CharacterSheetModel::readModelAsync(const QJsonObject& jsonObj, bool readRootSection, bool progressive)
+{
+    cancelPendingLoad();
+    auto objects= characterObjects(jsonObj["characters"].toArray());
+    auto promise= std::make_shared<QPromise<void>>();
+    promise->setProgressRange(0, static_cast<int>(objects.size()));
+    promise->start();
+
+    if(!progressive)
+    {
+        auto watcher= new QFutureWatcher<CharacterRecord>(this);
+        m_pendingLoad= watcher;
+        connect(watcher, &QFutureWatcherBase::progressValueChanged, this,
+                [promise](int value) { promise->setProgressValue(value); });
+        auto complete= [this, watcher, promise, readRootSection, data= jsonObj["data"].toObject()]()
+        {
+            m_pendingLoad.clear();
+            m_completeLoad= nullptr;
+            beginLoading();
+            if(readRootSection)
+                loadRootSection(data);
+            loadRecords(watcher->future().results());
+            endLoading();
+            promise->finish();
+            watcher->deleteLater();
+        };
+        connect(watcher, &QFutureWatcherBase::finished, this, complete);
+        m_completeLoad= complete;
+        watcher->setFuture(QtConcurrent::mapped(objects, &CharacterRecord::fromJson));
+        return promise->future();
+    }
+
+    // the structure and the first screenful of characters are shown at once.
+    auto const firstCount= std::min(objects.size(), static_cast<qsizetype>(firstScreenCharacterCount));
+    QList<CharacterRecord> firstRecords;
+    firstRecords.reserve(firstCount);
+    for(qsizetype i= 0; i < firstCount; ++i)
+        firstRecords.append(CharacterRecord::fromJson(objects.at(i)));
+    objects.remove(0, firstCount);
+
+    beginLoading();
     if(readRootSection)
+        loadRootSection(jsonObj["data"].toObject());
+    loadRecords(firstRecords);
+    endLoading();
+    promise->setProgressValue(static_cast<int>(firstCount));
+
+    // others are inserted as columns, in order, each time a run of them has been decoded.
+    auto watcher= new QFutureWatcher<CharacterRecord>(this);
+    m_pendingLoad= watcher;
+    auto next= std::make_shared<int>(0);
+    auto insertReady= [this, watcher, promise, next, firstCount]()
     {
-        QJsonObject data= jsonObj["data"].toObject();
-        m_rootSection->load(data, nullptr);
+        auto const future= watcher->future();
+        QList<CharacterRecord> batch;
+        while(future.isResultReadyAt(*next))
+            batch.append(future.resultAt((*next)++));
+        insertRecords(batch);
+        promise->setProgressValue(static_cast<int>(firstCount) + *next);
+    };
+    auto complete= [this, watcher, promise, insertReady]()
+    {
+        insertReady();
+        m_pendingLoad.clear();
+        m_completeLoad= nullptr;
+        promise->finish();
+        watcher->deleteLater();
+    };
+    connect(watcher, &QFutureWatcherBase::resultsReadyAt, this, insertReady);
+    connect(watcher, &QFutureWatcherBase::finished, this, complete);
+    m_completeLoad= complete;
+    watcher->setFuture(QtConcurrent::mapped(objects, &CharacterRecord::fromJson));
+    return promise->future();
+}
+
+void CharacterSheetModel::cancelPendingLoad()
+{
+    if(!m_pendingLoad)
+        return;
+
+    // the promise held by the connections is destroyed with the watcher, its future is then canceled.
+    m_pendingLoad->cancel();
+    m_pendingLoad->disconnect(this);
+    m_pendingLoad->deleteLater();
+    m_pendingLoad.clear();
+    m_completeLoad= nullptr;
+}
+
+void CharacterSheetModel::finishPendingLoad()
+{
+    if(!m_pendingLoad)
+        return;
+
+    // the results are taken here, the watcher must not deliver them again.
+    auto complete= std::move(m_completeLoad);
+    m_pendingLoad->disconnect(this);
+    m_pendingLoad->waitForFinished();
+    complete();
+}
+
+void CharacterSheetModel::beginLoading()
+{
+    cancelPendingLoad();
+    beginResetModel();
+}
+
+void CharacterSheetModel::loadRootSection(const QJsonObject& data)
+{
+    m_rootSection->load(data, nullptr);
+    // characters may have been read before the structure.
+    for(auto& sheet : m_characterList->loadedSheets())
+        sheet->setOrigin(m_rootSection);
+}
+
+CharacterSheet* CharacterSheetModel::loadCharacter(const QJsonObject& json)
+{
+    CharacterSheet* sheet= new CharacterSheet();
+    sheet->load(json);
+    appendLoadedSheet(sheet);
+    return sheet;
+}
+
+void CharacterSheetModel::loadRecords(const QList<CharacterRecord>& records)
+{
+    reservePools(static_cast<int>(records.size()));
+    for(auto const& record : records)
+    {
+        auto sheet= new CharacterSheet();
+        sheet->load(record, m_rootSection);
+        appendLoadedSheet(sheet);
     }
-    QJsonArray characters= jsonObj["characters"].toArray();
-    for(const auto charJson : characters)
+}
+
+void CharacterSheetModel::insertRecords(const QList<CharacterRecord>& records)
+{
+    if(records.isEmpty())
+        return;
+
+    reservePools(static_cast<int>(records.size()));
+    // the structure may have been edited since the load has started.
+    auto const structure= schemaOf(m_rootSection);
+    QList<CharacterSheet*> sheets;
+    sheets.reserve(records.size());
+    for(auto const& record : records)
     {
-        QJsonObject obj= charJson.toObject();
-        CharacterSheet* sheet= new CharacterSheet();
-        sheet->load(obj);
+        auto sheet= new CharacterSheet();
+        sheet->load(record, m_rootSection);
         sheet->setOrigin(m_rootSection);
+        CharacterPatch::plan(sheet, structure).apply(structure, m_rootSection);
+        sheets.append(sheet);
+    }
+
+    auto const first= columnCount();
+    beginInsertColumns(QModelIndex(), first, first + static_cast<int>(sheets.size()) - 1);
+    for(auto sheet : std::as_const(sheets))
+    {
         m_characterList->append(sheet);
+        connectSheet(sheet);
+    }
+    endInsertColumns();
+
+    for(auto sheet : std::as_const(sheets))
+    {
+        insertTableRows(sheet);
         emit characterSheetHasBeenAdded(sheet);
     }
+    emit dataCharacterChange();
+}
+
+void CharacterSheetModel::loadCharacterLater(const QByteArray& json)
+{
+    m_characterList->appendPending(json, sheetIdOf(json));
+}
+
+void CharacterSheetModel::endLoading()
+{
+    checkTableItem();
+    endResetModel();
+}
+
+CharacterSheet* CharacterSheetModel::materializeCharacter(const QByteArray& json)
+{
+    auto sheet= new CharacterSheet();
+    sheet->load(QJsonDocument::fromJson(json).object());
+    sheet->setOrigin(m_rootSection);
+
+    // the structure may have changed since the file has been read.
+    auto const structure= schemaOf(m_rootSection);
+    CharacterPatch::plan(sheet, structure).apply(structure, m_rootSection);
+
+    connectSheet(sheet);
+    m_unsyncedSheets.insert(sheet);
+
+    // characters are mostly built while views read the model, they are told about it at the next event loop.
+    QPointer<CharacterSheet> guard(sheet);
+    QMetaObject::invokeMethod(
+        this,
+        [this, guard]()
+        {
+            if(guard)
+                syncCharacter(guard);
+        },
+        Qt::QueuedConnection);
+    return sheet;
+}
+
+void CharacterSheetModel::syncCharacter(CharacterSheet* sheet)
+{
+    if(!m_unsyncedSheets.contains(sheet))
+        return;
+
+    insertTableRows(sheet);
+    m_unsyncedSheets.remove(sheet);
+    emit characterSheetHasBeenAdded(sheet);
+    m_characterList->trim();
+}
+
+void CharacterSheetModel::insertTableRows(CharacterSheet* sheet)
+{
+    for(int r= 0; r < m_rootSection->getChildrenCount(); ++r)
+    {
+        auto structTable= m_rootSection->getChildAt(r);
+        if(nullptr == structTable || CharacterSheetItem::TableItem != structTable->getItemType())
+            continue;
+
+        auto table= sheet->getFieldFromKey(structTable->getId());
+        if(nullptr == table)
+            continue;
+
+        auto parentIndex= createIndex(r, 0, structTable);
+        auto const oldRowCount= rowCount(parentIndex);
+        auto const newRowCount= table->getChildrenCount();
+        if(newRowCount <= oldRowCount)
+            continue;
+
+        beginInsertRows(parentIndex, oldRowCount, newRowCount - 1);
+        m_tableChildCounts.insert(structTable->getId(), newRowCount);
+        endInsertRows();
+    }
+}
+
+bool CharacterSheetModel::writeModel(QCborStreamWriter& writer, bool writeData)
+{
+    finishPendingLoad();
+    writer.startMap(writeData ? 4 : 3);
+    writer.append(qint64(VersionKey));
+    writer.append(cborVersion);
+    if(writeData)
+    {
+        writer.append(qint64(DataKey));
+        QCborValue::fromJsonValue(rootSectionData()).toCbor(writer);
+    }
+
+    // field ids are written once, characters give their values in the same order.
+    auto const count= m_rootSection->getChildrenCount();
+    writer.append(qint64(SchemaKey));
+    writer.startArray(static_cast<quint64>(count));
+    for(int i= 0; i < count; ++i)
+        writer.append(m_rootSection->getChildAt(i)->getId());
+    writer.endArray();
+
+    writer.append(qint64(CharactersKey));
+    writer.startArray(static_cast<quint64>(m_characterList->size()));
+    for(int i= 0; i < m_characterList->size(); ++i)
+    {
+        if(m_characterList->isLoaded(i))
+        {
+            m_characterList->at(i)->save(writer, m_rootSection);
+            continue;
+        }
+        // a temporary character is enough to convert the json, the model does not keep it.
+        CharacterSheet sheet;
+        sheet.load(QJsonDocument::fromJson(m_characterList->pendingData(i)).object());
+        sheet.save(writer, m_rootSection);
+    }
+    writer.endArray();
+    if(!writer.endMap())
+        return false;
+    m_characterList->markSaved();
+    return true;
+}
+
+bool CharacterSheetModel::readModel(QCborStreamReader& reader, bool readRootSection)
+{
+    if(!reader.isMap())
+        return false;
+
+    beginLoading();
+    QStringList keys;
+    reader.enterContainer();
+    while(reader.lastError() == QCborError::NoError && reader.hasNext())
+    {
+        auto const key= QCborValue::fromCbor(reader);
+        switch(key.toInteger(-1))
+        {
+        case DataKey:
+        {
+            auto data= QCborValue::fromCbor(reader);
+            if(readRootSection)
+                m_rootSection->load(data.toMap().toJsonObject(), nullptr);
+        }
+        break;
+        case SchemaKey:
+        {
+            auto const array= QCborValue::fromCbor(reader).toArray();
+            keys.reserve(array.size());
+            for(auto const& id : array)
+                keys.append(id.toString());
+        }
+        break;
+        case CharactersKey:
+        {
+            if(!reader.isArray())
+            {
+                QCborValue::fromCbor(reader);
+                break;
+            }
+            if(reader.isLengthKnown())
+                reservePools(static_cast<int>(reader.length()));
+            // characters are read by batches decoded on worker threads, the whole file is never held as a tree.
+            QList<QCborArray> batch;
+            auto const decode= [&keys](const QCborArray& array) { return CharacterRecord::fromCbor(array, keys); };
+            auto const flush= [this, &batch, &decode]()
+            {
+                loadRecords(QtConcurrent::blockingMapped<QList<CharacterRecord>>(batch, decode));
+                batch.clear();
+            };
+            reader.enterContainer();
+            while(reader.lastError() == QCborError::NoError && reader.hasNext())
+            {
+                batch.append(QCborValue::fromCbor(reader).toArray());
+                if(batch.size() == cborBatchSize)
+                    flush();
+            }
+            flush();
+            if(reader.lastError() == QCborError::NoError)
+                reader.leaveContainer();
+        }
+        break;
+        default:
+            // version and unknown keys
+            QCborValue::fromCbor(reader);
+            break;
+        }
+    }
+    if(reader.lastError() == QCborError::NoError)
+        reader.leaveContainer();
     checkTableItem();
     endResetModel();
+    return reader.lastError() == QCborError::NoError;
+}
+
+void CharacterSheetModel::reservePools(int characterCount)
+{
+    // size the pools from the schema: every character gets a copy of each table.
+    int cellCount= 0;
+    for(int i= 0; i < m_rootSection->getChildrenCount(); ++i)
+    {
+        auto child= m_rootSection->getChildAt(i);
+        if(nullptr != child && CharacterSheetItem::TableItem == child->getItemType())
+            cellCount+= child->getChildrenCount();
+    }
+    FieldController::pool().reserve(cellCount * characterCount);
+}
+
+void CharacterSheetModel::appendLoadedSheet(CharacterSheet* sheet)
+{
+    sheet->setOrigin(m_rootSection);
+    m_characterList->append(sheet);
+    connectSheet(sheet);
+    emit characterSheetHasBeenAdded(sheet);
+}
+
+void CharacterSheetModel::connectSheet(CharacterSheet* sheet)
+{
+    connect(sheet, &CharacterSheet::tableLinesChanged, this,
+            [this](CharacterSheet*, CharacterSheetItem* table)
+            {
+                invalidateCellCache();
+                updateTableChildCount(table);
+            });
+    connect(sheet, &CharacterSheet::tableCellsChanged, this, &CharacterSheetModel::markTableLinesChanged);
+    connect(sheet, &CharacterSheet::tableCellsReleased, this, [this]() { invalidateCellCache(); });
+    connect(sheet, &CharacterSheet::uuidChanged, this, [this, sheet]() { indexSheet(sheet); });
+    connect(sheet, &CharacterSheet::updateField, this, &CharacterSheetModel::fieldChanged);
+    auto modified= [this, sheet]() { m_characterList->markModified(sheet); };
+    connect(sheet, &CharacterSheet::updateField, this, modified);
+    connect(sheet, &CharacterSheet::nameChanged, this, modified);
+    connect(sheet, &CharacterSheet::tableLinesChanged, this, modified);
+    connect(sheet, &CharacterSheet::tableCellsChanged, this, modified);
+    indexSheet(sheet);
+}
+
+bool CharacterSheetModel::canReleaseCharacter(CharacterSheet* sheet) const
+{
+    return !sheet->isBound() && !m_unsyncedSheets.contains(sheet) && !m_handedOutSheets.contains(sheet);
+}
+
+void CharacterSheetModel::releaseCharacter(CharacterSheet* sheet)
+{
+    // views are not told about rows going away, the table rows of the character are kept.
+    for(int r= 0; r < m_rootSection->getChildrenCount(); ++r)
+    {
+        auto structTable= m_rootSection->getChildAt(r);
+        if(nullptr == structTable || CharacterSheetItem::TableItem != structTable->getItemType())
+            continue;
+        auto table= sheet->getFieldFromKey(structTable->getId());
+        if(nullptr == table)
+            continue;
+        auto& count= m_evictedTableChildCounts[structTable->getId()];
+        count= std::max(count, table->getChildrenCount());
+    }
+
+    emit characterSheetEvicted(sheet);
+    unindexSheet(sheet);
+    disconnect(sheet, nullptr, this, nullptr);
+    invalidateCellCache();
+}
+
+void CharacterSheetModel::setMemoryBudget(qint64 bytes)
+{
+    m_characterList->setMemoryBudget(bytes);
+}
+
+qint64 CharacterSheetModel::memoryBudget() const
+{
+    return m_characterList->memoryBudget();
+}
+
+void CharacterSheetModel::indexSheet(CharacterSheet* sheet)
+{
+    unindexSheet(sheet);
+    QUuid uuid(sheet->uuid());
+    if(!uuid.isNull())
+        m_sheetByUuid.insert(uuid, sheet);
+}
+
+void CharacterSheetModel::unindexSheet(CharacterSheet* sheet)
+{
+    auto current= m_sheetByUuid.find(QUuid(sheet->uuid()));
+    if(current != m_sheetByUuid.end() && current.value() == sheet)
+    {
+        m_sheetByUuid.erase(current);
+        return;
+    }
+    // the previous uuid is unknown when it has just changed, the sheet is found by value.
+    for(auto it= m_sheetByUuid.begin(); it != m_sheetByUuid.end();)
+    {
+        if(it.value() == sheet)
+            it= m_sheetByUuid.erase(it);
+        else
+            ++it;
+    }
+}
+
+int CharacterSheetModel::maxTableChildCount(const QString& key) const
+{
+    auto it= m_tableChildCounts.constFind(key);
+    if(it != m_tableChildCounts.constEnd())
+        return it.value();
+
+    int max= m_evictedTableChildCounts.value(key);
+    for(auto sheet : m_characterList->loadedSheets())
+    {
+        // characters just built are counted once views have been told about their lines.
+        if(m_unsyncedSheets.contains(sheet))
+            continue;
+        auto table= sheet->getFieldFromKey(key);
+        if(nullptr != table)
+            max= std::max(max, table->getChildrenCount());
+    }
+    m_tableChildCounts.insert(key, max);
+    return max;
+}
+
+void CharacterSheetModel::updateTableChildCount(CharacterSheetItem* table)
+{
+    auto it= m_tableChildCounts.find(table->getId());
+    if(it == m_tableChildCounts.end())
+        return;
+
+    auto count= table->getChildrenCount();
+    if(count >= it.value())
+        it.value()= count;
+    else // the table may have been the longest one, it is computed again when needed.
+        m_tableChildCounts.erase(it);
+}
+
+QString CharacterSheetModel::pathOf(CharacterSheetItem* item) const
+{
+    auto it= m_pathCache.find(item);
+    if(it == m_pathCache.end())
+        it= m_pathCache.insert(item, item->getPath());
+    return it.value();
+}
+
+CharacterSheetItem* CharacterSheetModel::tableCell(CharacterSheetItem* structureCell, int row,
+                                                   CharacterSheet* sheet) const
+{
+    QPair<const CharacterSheetItem*, const CharacterSheet*> key(structureCell, sheet);
+    auto it= m_tableCellCache.constFind(key);
+    if(it != m_tableCellCache.constEnd())
+        return it.value();
+
+    CharacterSheetItem* cell= nullptr;
+    auto table= sheet->getFieldFromKey(pathOf(structureCell->getParent()));
+    if(nullptr != table)
+        cell= table->getChildAt(row);
+    // looking for the cell may build the line and clear the cache.
+    m_tableCellCache.insert(key, cell);
+    return cell;
+}
+
+void CharacterSheetModel::invalidateCellCache() const
+{
+    m_pathCache.clear();
+    m_tableCellCache.clear();
 }
 
 void CharacterSheetModel::checkTableItem()
@@ -739,7 +1808,7 @@ void CharacterSheetModel::checkTableItem()
         auto child= m_rootSection->getChildAt(i);
         if(CharacterSheetItem::TableItem == child->getItemType())
         {
-            for(auto& character : *m_characterList)
+            for(auto& character : m_characterList->loadedSheets())
             {
                 auto childFromCharacter= character->getFieldAt(i);
                 auto table= dynamic_cast<TableField*>(child);
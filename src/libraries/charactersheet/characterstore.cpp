@@ -0,0 +1,313 @@
+#include "characterstore.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+
+#include "charactersheet/charactersheet.h"
+
+CharacterStore::CharacterStore(Loader loader) : m_loader(std::move(loader)) {}
+
+CharacterStore::~CharacterStore()
+{
+    clear();
+}
+
+int CharacterStore::size() const
+{
+    return static_cast<int>(m_slots.size());
+}
+
+bool CharacterStore::isEmpty() const
+{
+    return m_slots.isEmpty();
+}
+
+CharacterSheet* CharacterStore::at(int i) const
+{
+    if(i < 0 || i >= size())
+        return nullptr;
+
+    auto const& slot= m_slots.at(i);
+    slot.lastAccess= ++m_clock;
+    if(nullptr == slot.sheet && m_loader)
+    {
+        auto json= slot.diskOffset < 0 ? slot.json : readCache(slot);
+        unindexUnloaded(i);
+        slot.sheet= m_loader(json);
+        slot.cost= json.size();
+        slot.clean= true;
+        slot.json.clear();
+        slot.diskOffset= -1;
+        slot.diskSize= 0;
+    }
+    return slot.sheet;
+}
+
+bool CharacterStore::isLoaded(int i) const
+{
+    return i >= 0 && i < size() && nullptr != m_slots.at(i).sheet;
+}
+
+QByteArray CharacterStore::pendingData(int i) const
+{
+    if(i < 0 || i >= size())
+        return {};
+    auto const& slot= m_slots.at(i);
+    return slot.diskOffset < 0 ? slot.json : readCache(slot);
+}
+
+int CharacterStore::indexOf(const CharacterSheet* sheet) const
+{
+    if(nullptr == sheet)
+        return -1;
+
+    for(int i= 0; i < size(); ++i)
+    {
+        if(m_slots.at(i).sheet == sheet)
+            return i;
+    }
+    return -1;
+}
+
+QList<CharacterSheet*> CharacterStore::loadedSheets() const
+{
+    QList<CharacterSheet*> sheets;
+    sheets.reserve(m_slots.size());
+    for(auto const& slot : m_slots)
+    {
+        if(nullptr != slot.sheet)
+            sheets.append(slot.sheet);
+    }
+    return sheets;
+}
+
+void CharacterStore::insert(int pos, CharacterSheet* sheet)
+{
+    Slot slot;
+    slot.sheet= sheet;
+    shiftUnloaded(pos, 1);
+    m_slots.insert(pos, slot);
+}
+
+void CharacterStore::append(CharacterSheet* sheet)
+{
+    insert(size(), sheet);
+}
+
+void CharacterStore::appendPending(const QByteArray& json, const QString& id)
+{
+    Slot slot;
+    slot.json= json;
+    slot.id= id;
+    slot.uuid= QUuid(id);
+    m_slots.append(slot);
+    indexUnloaded(size() - 1);
+}
+
+int CharacterStore::indexOfUnloaded(const QString& id) const
+{
+    // uuid are compared as values, the braces may differ between the files and the network.
+    QUuid const uuid(id);
+    if(!uuid.isNull())
+        return m_unloadedByUuid.value(uuid, -1);
+    return id.isEmpty() ? -1 : m_unloadedById.value(id, -1);
+}
+
+CharacterSheet* CharacterStore::takeAt(int i)
+{
+    if(i < 0 || i >= size())
+        return nullptr;
+    unindexUnloaded(i);
+    auto sheet= m_slots.takeAt(i).sheet;
+    shiftUnloaded(i + 1, -1);
+    return sheet;
+}
+
+void CharacterStore::clear()
+{
+    for(auto const& slot : m_slots)
+        delete slot.sheet;
+    m_slots.clear();
+    m_unloadedByUuid.clear();
+    m_unloadedById.clear();
+    if(m_cache.isOpen())
+        m_cache.resize(0);
+}
+
+void CharacterStore::setEvictor(Evictor evictor, Releaser releaser)
+{
+    m_evictor= std::move(evictor);
+    m_releaser= std::move(releaser);
+}
+
+void CharacterStore::setMemoryBudget(qint64 bytes)
+{
+    m_budget= std::max<qint64>(0, bytes);
+    trim();
+}
+
+qint64 CharacterStore::memoryBudget() const
+{
+    return m_budget;
+}
+
+qint64 CharacterStore::residentCost() const
+{
+    qint64 cost= 0;
+    for(auto const& slot : m_slots)
+    {
+        if(nullptr != slot.sheet)
+            cost+= this->cost(slot);
+    }
+    return cost;
+}
+
+void CharacterStore::markModified(const CharacterSheet* sheet)
+{
+    auto i= indexOf(sheet);
+    if(i < 0)
+        return;
+    // the character is measured again at the next trim.
+    m_slots[i].clean= false;
+    m_slots[i].cost= 0;
+}
+
+void CharacterStore::markSaved()
+{
+    for(auto& slot : m_slots)
+    {
+        if(nullptr != slot.sheet)
+            slot.clean= true;
+    }
+}
+
+void CharacterStore::trim()
+{
+    if(m_budget <= 0)
+        return;
+
+    auto resident= residentCost();
+    if(resident <= m_budget)
+        return;
+
+    QList<int> candidates;
+    for(int i= 0; i < size(); ++i)
+    {
+        auto const& slot= m_slots.at(i);
+        if(nullptr != slot.sheet && slot.clean)
+            candidates.append(i);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [this](int a, int b) { return m_slots.at(a).lastAccess < m_slots.at(b).lastAccess; });
+
+    for(auto i : candidates)
+    {
+        if(resident <= m_budget)
+            break;
+        auto& slot= m_slots[i];
+        auto const cost= this->cost(slot);
+        if(evict(slot))
+        {
+            indexUnloaded(i);
+            resident-= cost;
+        }
+    }
+}
+
+bool CharacterStore::evict(Slot& slot)
+{
+    // characters in use are not serialized for nothing.
+    if(m_evictor && !m_evictor(slot.sheet))
+        return false;
+    if(!m_cache.isOpen() && !m_cache.open())
+        return false;
+
+    QJsonObject json;
+    slot.sheet->save(json);
+    auto const data= qCompress(QJsonDocument(json).toJson(QJsonDocument::Compact));
+
+    // the cache only grows while the store lives, it is emptied by clear.
+    auto const offset= m_cache.size();
+    if(!m_cache.seek(offset) || m_cache.write(data) != data.size())
+        return false;
+
+    // the character is detached from the model once the data are safe.
+    if(m_releaser)
+        m_releaser(slot.sheet);
+
+    slot.diskOffset= offset;
+    slot.diskSize= static_cast<int>(data.size());
+    slot.id= slot.sheet->uuid();
+    slot.uuid= QUuid(slot.id);
+    slot.sheet->deleteLater();
+    slot.sheet= nullptr;
+    slot.clean= false;
+    return true;
+}
+
+qint64 CharacterStore::cost(const Slot& slot) const
+{
+    // characters added already built, or modified since, are measured from their json.
+    if(0 == slot.cost && nullptr != slot.sheet)
+    {
+        QJsonObject json;
+        slot.sheet->save(json);
+        slot.cost= QJsonDocument(json).toJson(QJsonDocument::Compact).size();
+    }
+    return slot.cost;
+}
+
+void CharacterStore::indexUnloaded(int i) const
+{
+    // a duplicated uuid gives the first slot.
+    auto const& slot= m_slots.at(i);
+    if(!slot.uuid.isNull())
+    {
+        auto it= m_unloadedByUuid.find(slot.uuid);
+        if(it == m_unloadedByUuid.end() || it.value() > i)
+            m_unloadedByUuid.insert(slot.uuid, i);
+    }
+    else if(!slot.id.isEmpty())
+    {
+        auto it= m_unloadedById.find(slot.id);
+        if(it == m_unloadedById.end() || it.value() > i)
+            m_unloadedById.insert(slot.id, i);
+    }
+}
+
+void CharacterStore::unindexUnloaded(int i) const
+{
+    auto const& slot= m_slots.at(i);
+    if(!slot.uuid.isNull())
+    {
+        if(m_unloadedByUuid.value(slot.uuid, -1) == i)
+            m_unloadedByUuid.remove(slot.uuid);
+    }
+    else if(m_unloadedById.value(slot.id, -1) == i)
+    {
+        m_unloadedById.remove(slot.id);
+    }
+}
+
+void CharacterStore::shiftUnloaded(int from, int delta)
+{
+    // only structural changes pay for it, lookups stay constant.
+    for(auto& pos : m_unloadedByUuid)
+    {
+        if(pos >= from)
+            pos+= delta;
+    }
+    for(auto& pos : m_unloadedById)
+    {
+        if(pos >= from)
+            pos+= delta;
+    }
+}
+
+QByteArray CharacterStore::readCache(const Slot& slot) const
+{
+    if(!m_cache.isOpen() || !m_cache.seek(slot.diskOffset))
+        return {};
+    return qUncompress(m_cache.read(slot.diskSize));
+}
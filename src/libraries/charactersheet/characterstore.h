@@ -0,0 +1,133 @@
+#ifndef CHARACTERSTORE_H
+#define CHARACTERSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QTemporaryFile>
+#include <QUuid>
+#include <functional>
+
+class CharacterSheet;
+
+/**
+ * @brief The CharacterStore class keeps the characters of the model in column order. A character read in
+ * indexed mode only keeps its json text until it is first requested, the loader builds it then.
+ * Loaded characters belong to the store.
+ *
+ * With a memory budget, the least recently used characters which have not been modified since they were built
+ * are written to a compressed cache file and deleted, they are built again from it on next access.
+ */
+class CharacterStore
+{
+public:
+    using Loader= std::function<CharacterSheet*(const QByteArray& json)>;
+    /**
+     * @brief Evictor is asked before a character is evicted, it returns false if the character is in use.
+     */
+    using Evictor= std::function<bool(CharacterSheet* sheet)>;
+    /**
+     * @brief Releaser detaches the character from its users once its data are in the cache.
+     */
+    using Releaser= std::function<void(CharacterSheet* sheet)>;
+
+    explicit CharacterStore(Loader loader);
+    ~CharacterStore();
+
+    CharacterStore(const CharacterStore&)= delete;
+    CharacterStore& operator=(const CharacterStore&)= delete;
+
+    int size() const;
+    bool isEmpty() const;
+    /**
+     * @brief at gives the character of the slot, it is built if needed.
+     */
+    CharacterSheet* at(int i) const;
+    bool isLoaded(int i) const;
+    /**
+     * @brief pendingData gives the json of a slot which has not been built yet.
+     */
+    QByteArray pendingData(int i) const;
+    int indexOf(const CharacterSheet* sheet) const;
+    /**
+     * @brief loadedSheets gives the characters already built, the other slots are left untouched.
+     */
+    QList<CharacterSheet*> loadedSheets() const;
+
+    void insert(int pos, CharacterSheet* sheet);
+    void append(CharacterSheet* sheet);
+    /**
+     * @brief appendPending adds a character which is built on first access, id is the uuid written in its json.
+     */
+    void appendPending(const QByteArray& json, const QString& id= QString());
+    /**
+     * @brief indexOfUnloaded finds a character not built yet or evicted from its uuid, its json is not read.
+     * Those slots are indexed by uuid, the lookup does not depend on the number of characters.
+     */
+    int indexOfUnloaded(const QString& id) const;
+    /**
+     * @brief takeAt removes the slot, the character is given back to the caller (null if it was never built).
+     */
+    CharacterSheet* takeAt(int i);
+    /**
+     * @brief clear removes all slots and deletes the loaded characters.
+     */
+    void clear();
+
+    void setEvictor(Evictor evictor, Releaser releaser);
+    /**
+     * @brief setMemoryBudget sets the size of the json of the built characters to keep, 0 means no limit.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    qint64 residentCost() const;
+    /**
+     * @brief markModified keeps the character in memory, only unmodified characters are evicted.
+     */
+    void markModified(const CharacterSheet* sheet);
+    /**
+     * @brief markSaved tells the built characters have been saved, they may be evicted again.
+     */
+    void markSaved();
+    /**
+     * @brief trim evicts least recently used characters until the budget is respected.
+     */
+    void trim();
+
+private:
+    struct Slot
+    {
+        mutable CharacterSheet* sheet= nullptr;
+        mutable QByteArray json;
+        mutable qint64 diskOffset= -1;
+        mutable int diskSize= 0;
+        mutable quint64 lastAccess= 0;
+        mutable qint64 cost= 0; // 0 until measured by trim
+        mutable bool clean= false; // built from json and not modified since
+        // uuid of the character while it is not built.
+        QString id;
+        QUuid uuid;
+    };
+    QByteArray readCache(const Slot& slot) const;
+    void indexUnloaded(int i) const;
+    void unindexUnloaded(int i) const;
+    void shiftUnloaded(int from, int delta);
+    bool evict(Slot& slot);
+    qint64 cost(const Slot& slot) const;
+
+private:
+    Loader m_loader;
+    Evictor m_evictor;
+    Releaser m_releaser;
+    QList<Slot> m_slots;
+    /**
+     * @brief slots not built yet or evicted by uuid, ids which are not uuids are kept as they are.
+     */
+    mutable QHash<QUuid, int> m_unloadedByUuid;
+    mutable QHash<QString, int> m_unloadedById;
+    qint64 m_budget= 0;
+    mutable quint64 m_clock= 0;
+    mutable QTemporaryFile m_cache;
+};
+
+#endif // CHARACTERSTORE_H
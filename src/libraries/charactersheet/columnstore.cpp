@@ -0,0 +1,220 @@
+#include "columnstore.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace columnkernels
+{
+// The loops below have no early exit and no data dependent branch so they are turned into SIMD code.
+qint64 sum(const int* values, std::size_t size)
+{
+    qint64 result= 0;
+    for(std::size_t i= 0; i < size; ++i)
+        result+= values[i];
+    return result;
+}
+
+int count(const quint8* numeric, std::size_t size)
+{
+    int result= 0;
+    for(std::size_t i= 0; i < size; ++i)
+        result+= numeric[i];
+    return result;
+}
+
+int min(const int* values, const quint8* numeric, std::size_t size)
+{
+    int result= std::numeric_limits<int>::max();
+    for(std::size_t i= 0; i < size; ++i)
+    {
+        auto const value= numeric[i] ? values[i] : std::numeric_limits<int>::max();
+        result= std::min(result, value);
+    }
+    return result;
+}
+
+int max(const int* values, const quint8* numeric, std::size_t size)
+{
+    int result= std::numeric_limits<int>::min();
+    for(std::size_t i= 0; i < size; ++i)
+    {
+        auto const value= numeric[i] ? values[i] : std::numeric_limits<int>::min();
+        result= std::max(result, value);
+    }
+    return result;
+}
+} // namespace columnkernels
+
+double ColumnAggregate::average() const
+{
+    if(count == 0)
+        return 0.;
+    return static_cast<double>(sum) / count;
+}
+
+void ColumnStore::clear()
+{
+    m_columns.clear();
+    m_rowCount= 0;
+}
+
+void ColumnStore::reserve(int rowCount, int columnCount)
+{
+    ensureColumns(columnCount);
+    for(auto& column : m_columns)
+    {
+        column.values.reserve(static_cast<std::size_t>(rowCount));
+        column.numeric.reserve(static_cast<std::size_t>(rowCount));
+    }
+}
+
+int ColumnStore::rowCount() const
+{
+    return m_rowCount;
+}
+
+int ColumnStore::columnCount() const
+{
+    return static_cast<int>(m_columns.size());
+}
+
+void ColumnStore::ensureColumns(int count)
+{
+    if(count <= columnCount())
+        return;
+
+    m_columns.resize(static_cast<std::size_t>(count));
+    for(auto& column : m_columns)
+    {
+        // columns added late are padded for the rows already there.
+        column.values.resize(static_cast<std::size_t>(m_rowCount), 0);
+        column.numeric.resize(static_cast<std::size_t>(m_rowCount), 0);
+    }
+}
+
+void ColumnStore::insertRow(int row, const QStringList& values)
+{
+    if(row < 0 || row > m_rowCount)
+        return;
+
+    ensureColumns(values.size());
+    auto const pos= static_cast<std::size_t>(row);
+    for(int i= 0; i < columnCount(); ++i)
+    {
+        auto& column= m_columns[static_cast<std::size_t>(i)];
+        bool ok= false;
+        int value= i < values.size() ? values.at(i).toInt(&ok) : 0;
+        column.values.insert(column.values.begin() + pos, ok ? value : 0);
+        column.numeric.insert(column.numeric.begin() + pos, ok ? 1 : 0);
+        if(column.dirty || !ok)
+            continue;
+
+        // a new value can only widen the bounds, the aggregate stays exact.
+        auto& agg= column.aggregate;
+        agg.sum+= value;
+        ++agg.count;
+        agg.min= agg.count == 1 ? value : std::min(agg.min, value);
+        agg.max= agg.count == 1 ? value : std::max(agg.max, value);
+    }
+    ++m_rowCount;
+}
+
+void ColumnStore::appendRow(const QStringList& values)
+{
+    insertRow(m_rowCount, values);
+}
+
+void ColumnStore::removeRow(int row)
+{
+    removeRows(row, row);
+}
+
+void ColumnStore::removeRows(int first, int last)
+{
+    if(first < 0 || last >= m_rowCount || first > last)
+        return;
+
+    auto const begin= static_cast<std::size_t>(first);
+    auto const end= static_cast<std::size_t>(last) + 1;
+    for(auto& column : m_columns)
+    {
+        if(!column.dirty)
+        {
+            // only the removed cells are read, the column is scanned again only if a bound is removed.
+            auto& agg= column.aggregate;
+            for(auto i= begin; i < end; ++i)
+            {
+                if(!column.numeric[i])
+                    continue;
+                auto const value= column.values[i];
+                agg.sum-= value;
+                --agg.count;
+                if(value == agg.min || value == agg.max)
+                    column.dirty= true;
+            }
+            if(agg.count == 0)
+            {
+                agg.min= 0;
+                agg.max= 0;
+                column.dirty= false;
+            }
+        }
+        column.values.erase(column.values.begin() + begin, column.values.begin() + end);
+        column.numeric.erase(column.numeric.begin() + begin, column.numeric.begin() + end);
+    }
+    m_rowCount-= last - first + 1;
+}
+
+void ColumnStore::setCell(int row, int column, const QString& value)
+{
+    if(row < 0 || row >= m_rowCount || column < 0 || column >= columnCount())
+        return;
+
+    auto& col= m_columns[static_cast<std::size_t>(column)];
+    auto const pos= static_cast<std::size_t>(row);
+    auto const oldValue= col.values[pos];
+    auto const oldNumeric= col.numeric[pos];
+
+    bool ok= false;
+    auto const newValue= value.toInt(&ok);
+    col.values[pos]= ok ? newValue : 0;
+    col.numeric[pos]= ok ? 1 : 0;
+
+    if(col.dirty)
+        return;
+
+    // keep the aggregate up to date when it is cheap, otherwise the kernels run at next read.
+    auto& agg= col.aggregate;
+    agg.sum+= col.values[pos] - oldValue;
+    agg.count+= col.numeric[pos] - oldNumeric;
+    if(oldNumeric && (oldValue == agg.min || oldValue == agg.max))
+    {
+        col.dirty= true;
+        return;
+    }
+    if(ok)
+    {
+        agg.min= agg.count == 1 ? newValue : std::min(agg.min, newValue);
+        agg.max= agg.count == 1 ? newValue : std::max(agg.max, newValue);
+    }
+}
+
+const ColumnAggregate& ColumnStore::aggregate(int column) const
+{
+    static const ColumnAggregate empty;
+    if(column < 0 || column >= columnCount())
+        return empty;
+
+    auto const& col= m_columns[static_cast<std::size_t>(column)];
+    if(col.dirty)
+    {
+        auto const size= col.values.size();
+        auto& agg= col.aggregate;
+        agg.sum= columnkernels::sum(col.values.data(), size);
+        agg.count= columnkernels::count(col.numeric.data(), size);
+        agg.min= agg.count > 0 ? columnkernels::min(col.values.data(), col.numeric.data(), size) : 0;
+        agg.max= agg.count > 0 ? columnkernels::max(col.values.data(), col.numeric.data(), size) : 0;
+        col.dirty= false;
+    }
+    return col.aggregate;
+}
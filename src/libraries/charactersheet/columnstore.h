@@ -0,0 +1,72 @@
+#ifndef COLUMNSTORE_H
+#define COLUMNSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+#include <vector>
+
+/**
+ * @brief The ColumnAggregate struct gathers the statistics of the numeric cells of one column.
+ */
+struct ColumnAggregate
+{
+    qint64 sum= 0;
+    int count= 0;
+    int min= 0;
+    int max= 0;
+    double average() const;
+};
+
+/**
+ * @brief The ColumnStore class keeps the integer value of every table cell in one contiguous array per column.
+ * Rows are in the same order as the lines of the LineModel. Aggregates follow inserted, removed and edited cells,
+ * kernels run over the arrays (they are written to be vectorized) only when a min or max value goes away.
+ */
+class ColumnStore
+{
+public:
+    void clear();
+    /**
+     * @brief reserve avoids reallocations when many rows are about to be inserted.
+     */
+    void reserve(int rowCount, int columnCount);
+
+    int rowCount() const;
+    int columnCount() const;
+
+    void insertRow(int row, const QStringList& values);
+    void appendRow(const QStringList& values);
+    void removeRow(int row);
+    void removeRows(int first, int last);
+    void setCell(int row, int column, const QString& value);
+
+    /**
+     * @brief aggregate is computed again only if one cell of the column has changed since the last call.
+     */
+    const ColumnAggregate& aggregate(int column) const;
+
+private:
+    struct Column
+    {
+        std::vector<int> values;      // 0 when the cell is not a number
+        std::vector<quint8> numeric;  // 1 when the cell is a number
+        mutable ColumnAggregate aggregate;
+        mutable bool dirty= true;
+    };
+    void ensureColumns(int count);
+
+private:
+    std::vector<Column> m_columns;
+    int m_rowCount= 0;
+};
+
+namespace columnkernels
+{
+qint64 sum(const int* values, std::size_t size);
+int count(const quint8* numeric, std::size_t size);
+int min(const int* values, const quint8* numeric, std::size_t size);
+int max(const int* values, const quint8* numeric, std::size_t size);
+} // namespace columnkernels
+
+#endif // COLUMNSTORE_H
@@ -20,6 +20,7 @@
  * 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.                 *
  ***************************************************************************/
 #include "field.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QJsonArray>
 #include <QMouseEvent>
@@ -55,6 +56,27 @@ FieldController::~FieldController()
     m_canvasField= nullptr;
 #endif
 }
+namespace
+{
+void drainFieldPool()
+{
+    FieldController::pool().setCapacity(0);
+}
+} // namespace
+
+ObjectPool<FieldController>& FieldController::pool()
+{
+    static ObjectPool<FieldController> pool([]() { return new FieldController(false); });
+    // pooled fields are QObjects, they are deleted with the application rather than at static destruction.
+    static const bool drained= []()
+    {
+        qAddPostRoutine(drainFieldPool);
+        return true;
+    }();
+    Q_UNUSED(drained)
+    return pool;
+}
+
 void FieldController::init()
 {
 #ifdef RCSE
@@ -508,12 +530,25 @@ qreal FieldController::getY() const
 }
 void FieldController::loadDataItem(const QJsonObject& json)
 {
-    m_id= json["id"].toString();
+    setId(json["id"].toString());
     setValue(json["value"].toString(), true);
     setLabel(json["label"].toString());
     setFormula(json["formula"].toString());
     setReadOnly(json["readonly"].toBool());
-    m_currentType= static_cast<FieldController::TypeField>(json["typefield"].toInt());
+    setCurrentType(static_cast<FieldController::TypeField>(json["typefield"].toInt()));
+}
+
+void FieldController::copyDataItem(const FieldController* src)
+{
+    if(nullptr == src)
+        return;
+
+    m_id= src->m_id;
+    m_value= src->m_value;
+    m_label= src->m_label;
+    m_formula= src->m_formula;
+    m_readOnly= src->m_readOnly;
+    m_currentType= src->m_currentType;
 }
 
 void FieldController::saveDataItem(QJsonObject& json)
@@ -644,6 +679,22 @@ void FieldController::setLocked(bool b)
 #endif
 }
 
+void FieldController::copyPresentation(const FieldController* src)
+{
+    if(nullptr == src)
+        return;
+
+    setRect(src->getRect());
+    setBorder(src->border());
+    setFont(src->font());
+    setBgColor(src->bgColor());
+    setTextColor(src->textColor());
+    setTextAlign(src->m_textAlign);
+    setAvailableValue(src->getAvailableValue());
+    setFitFont(src->fitFont());
+    setPage(src->getPage());
+}
+
 void FieldController::copyField(CharacterSheetItem* oldItem, bool copyData, bool sameId)
 {
     FieldController* oldField= dynamic_cast<FieldController*>(oldItem);
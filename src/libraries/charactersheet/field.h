@@ -28,6 +28,7 @@
 
 #include "charactersheet/charactersheetitem.h"
 #include "csitem.h"
+#include "objectpool.h"
 
 #ifdef RCSE
 #include "canvasfield.h"
@@ -87,6 +88,12 @@ public:
      * @param scene
      */
     virtual void loadDataItem(const QJsonObject& json) override;
+    /**
+     * @brief copyDataItem copies the data handled by loadDataItem from another field.
+     * It is meant to fill freshly built fields, no signal is emitted.
+     * @param src
+     */
+    void copyDataItem(const FieldController* src);
 
     virtual QPointF mapFromScene(QPointF) override;
 
@@ -96,6 +103,11 @@ public:
     virtual CharacterSheetItem::CharacterSheetItemType getItemType() const override;
 
     void copyField(CharacterSheetItem*, bool copyData, bool sameId= true);
+    /**
+     * @brief copyPresentation copies how the field is drawn (geometry, border, font, colors, alignment, choices),
+     * the data of the field are left untouched.
+     */
+    void copyPresentation(const FieldController* src);
 
     bool fitFont() const;
 
@@ -130,6 +142,11 @@ public:
 
     QPair<QString, QString> getTextAlign();
     bool isLocked() const;
+
+    /**
+     * @brief pool builds fields of character data by batch (table cells, fields built on demand).
+     */
+    static ObjectPool<FieldController>& pool();
 public slots:
     void setLocked(bool b);
     void storeQMLCode();
@@ -0,0 +1,108 @@
+#include "charactersheet/fieldvalue.h"
+
+FieldValue FieldValue::fromJson(const QJsonObject& json)
+{
+    FieldValue field;
+    field.id= json["id"].toString();
+    field.label= json["label"].toString();
+    field.value= json["value"].toString();
+    field.formula= json["formula"].toString();
+    field.readOnly= json["readonly"].toBool();
+    field.typeField= static_cast<CharacterSheetItem::TypeField>(json["typefield"].toInt());
+    if(json.contains("type"))
+        field.type= json["type"].toString();
+    return field;
+}
+
+FieldValue FieldValue::fromItem(const CharacterSheetItem* item)
+{
+    FieldValue field;
+    if(nullptr == item)
+        return field;
+
+    field.id= item->getId();
+    field.label= item->getLabel();
+    field.value= item->value();
+    field.formula= item->getFormula();
+    field.readOnly= item->isReadOnly();
+    field.typeField= item->getFieldType();
+    return field;
+}
+
+void FieldValue::toJson(QJsonObject& json) const
+{
+    json["type"]= type;
+    json["typefield"]= typeField;
+    json["id"]= id;
+    json["label"]= label;
+    json["value"]= value;
+    json["formula"]= formula;
+    json["readonly"]= readOnly;
+}
+
+FieldValue FieldValue::fromCbor(const QCborMap& map, const QString& id, const CharacterSheetItem* schema)
+{
+    FieldValue field;
+    field.id= id;
+    field.value= map.value(CborValueKey).toString();
+    field.formula= map.value(CborFormulaKey).toString();
+    field.readOnly= map.value(CborReadOnlyKey).toBool();
+    if(nullptr != schema)
+    {
+        field.label= schema->getLabel();
+        field.typeField= schema->getFieldType();
+    }
+    if(map.contains(CborLabelKey))
+        field.label= map.value(CborLabelKey).toString();
+    if(map.contains(CborTypeFieldKey))
+        field.typeField= static_cast<CharacterSheetItem::TypeField>(map.value(CborTypeFieldKey).toInteger());
+    if(map.contains(CborTypeKey))
+        field.type= map.value(CborTypeKey).toString();
+    return field;
+}
+
+void FieldValue::toCbor(QCborStreamWriter& writer, const CharacterSheetItem* schema) const
+{
+    writer.startMap();
+    writer.append(qint64(CborValueKey));
+    writer.append(value);
+    if(!formula.isEmpty())
+    {
+        writer.append(qint64(CborFormulaKey));
+        writer.append(formula);
+    }
+    if(readOnly)
+    {
+        writer.append(qint64(CborReadOnlyKey));
+        writer.append(readOnly);
+    }
+    if(nullptr == schema || schema->getLabel() != label)
+    {
+        writer.append(qint64(CborLabelKey));
+        writer.append(label);
+    }
+    if(nullptr == schema || schema->getFieldType() != typeField)
+    {
+        writer.append(qint64(CborTypeFieldKey));
+        writer.append(qint64(typeField));
+    }
+    if(type != QStringLiteral("field"))
+    {
+        writer.append(qint64(CborTypeKey));
+        writer.append(type);
+    }
+    writer.endMap();
+}
+
+void FieldValue::applyTo(CharacterSheetItem* item) const
+{
+    if(nullptr == item)
+        return;
+
+    item->setId(id);
+    item->setValue(value, true);
+    item->setLabel(label);
+    item->setFormula(formula);
+    item->setReadOnly(readOnly);
+    item->setCurrentType(typeField);
+}
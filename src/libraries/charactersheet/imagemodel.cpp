@@ -2,13 +2,26 @@
 #include <QBuffer>
 #include <QDebug>
 #include <QIcon>
+#include <QImage>
 #include <QPixmap>
 #include <QVariant>
+#include <QtConcurrent>
 
 #define TOOLTIP_SIZE 256
 
 namespace charactersheet
 {
+namespace
+{
+QString encodeImage(const QImage& image)
+{
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return QString(bytes.toBase64());
+}
+} // namespace
 
 ImageModel::ImageModel(QObject* parent) : QAbstractTableModel(parent)
 {
@@ -47,22 +60,57 @@ QVariant ImageModel::data(const QModelIndex& index, int role) const
     if(!index.isValid())
         return QVariant();
 
-    QVariant var;
     const auto& info= m_data[static_cast<std::size_t>(index.row())];
+    if(Qt::ToolTipRole == role)
+        return toolTip(info);
 
-    auto trueRole= role;
-    auto col= index.column();
+    return infoData(info, index.column(), role);
+}
 
-    if(Qt::ToolTipRole == role)
+void ImageModel::multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const
+{
+    for(auto& roleData : roleDataSpan)
+        roleData.clearData();
+
+    if(!index.isValid())
+        return;
+
+    // the tooltip renders a thumbnail, views fetching every role of a row do not get it.
+    const auto& info= m_data[static_cast<std::size_t>(index.row())];
+    auto const toolTipOnly= roleDataSpan.size() == 1;
+    for(auto& roleData : roleDataSpan)
+    {
+        if(Qt::ToolTipRole != roleData.role())
+            roleData.setData(infoData(info, index.column(), roleData.role()));
+        else if(toolTipOnly)
+            roleData.setData(toolTip(info));
+    }
+}
+
+QHash<int, QByteArray> ImageModel::roleNames() const
+{
+    auto roles= QAbstractTableModel::roleNames();
+    roles.remove(Qt::ToolTipRole);
+    return roles;
+}
+
+QVariant ImageModel::toolTip(const ImageInfo& info) const
+{
+    if(info.toolTip.isEmpty())
     {
-        auto key= info.key;
-        const auto& image= info.pixmap;
-        auto pixmap= image.scaledToWidth(TOOLTIP_SIZE);
+        auto pixmap= info.pixmap.scaledToWidth(TOOLTIP_SIZE);
         QByteArray data;
         QBuffer buffer(&data);
         pixmap.save(&buffer, "PNG", 100);
-        return QVariant::fromValue(QString("<img src='data:image/png;base64, %0'>").arg(QString(data.toBase64())));
+        info.toolTip= QString("<img src='data:image/png;base64, %0'>").arg(QString(data.toBase64()));
     }
+    return QVariant::fromValue(info.toolTip);
+}
+
+QVariant ImageModel::infoData(const ImageInfo& info, int col, int role) const
+{
+    QVariant var;
+    auto trueRole= role;
 
     std::vector<int> ap({Qt::EditRole, Qt::DisplayRole, FilenameRole, BackgroundRole, UrlRole, KeyRole});
 
@@ -124,16 +172,31 @@ bool ImageModel::setData(const QModelIndex& index, const QVariant& value, int ro
     return val;
 }
 
-void ImageModel::save(QJsonArray& array) const
+void ImageModel::save(QJsonArray& array, bool parallel) const
 {
+    if(parallel)
+    {
+        // pixmaps are bound to the GUI thread, workers encode QImage copies.
+        QList<QImage> images;
+        QList<const ImageInfo*> infos;
+        for(const auto& info : m_data)
+        {
+            if(!info.encoded.isEmpty())
+                continue;
+            images.append(info.pixmap.toImage());
+            infos.append(&info);
+        }
+        auto const encoded= QtConcurrent::blockingMapped<QList<QString>>(images, &encodeImage);
+        for(int i= 0; i < infos.size(); ++i)
+            infos.at(i)->encoded= encoded.at(i);
+    }
+
     for(const auto& info : m_data)
     {
         QJsonObject oj;
-        QByteArray bytes;
-        QBuffer buffer(&bytes);
-        buffer.open(QIODevice::WriteOnly);
-        info.pixmap.save(&buffer, "PNG");
-        oj["bin"]= QString(buffer.data().toBase64());
+        if(info.encoded.isEmpty())
+            info.encoded= encodeImage(info.pixmap.toImage());
+        oj["bin"]= info.encoded;
         oj["key"]= info.key;
         oj["isBg"]= info.isBackground;
         oj["filename"]= info.filename;
@@ -144,19 +207,30 @@ void ImageModel::save(QJsonArray& array) const
 void ImageModel::load(const QJsonArray& array)
 {
     for(const auto& imgVal : array)
+        loadImage(imgVal.toObject());
+}
+
+bool ImageModel::loadImage(const QJsonObject& imgInfo)
+{
+    auto imgKey= imgInfo["key"].toString();
+    auto imgIsBg= imgInfo["isBg"].toBool();
+    auto filename= imgInfo["filename"].toString();
+
+    auto const encoded= imgInfo["bin"].toString();
+    QPixmap map;
     {
-        auto imgInfo= imgVal.toObject();
-        auto imgData= imgInfo["bin"].toString();
-        auto imgKey= imgInfo["key"].toString();
-        auto imgIsBg= imgInfo["isBg"].toBool();
-        auto filename= imgInfo["filename"].toString();
-
-        auto data= QByteArray::fromBase64(imgData.toLocal8Bit());
-        QPixmap map;
+        // the decoded bytes are dropped before the pixmap is stored.
+        auto data= QByteArray::fromBase64(encoded.toLatin1());
         map.loadFromData(data, "PNG");
-
-        insertImage(map, imgKey, filename, imgIsBg);
     }
+    if(!insertImage(map, imgKey, filename, imgIsBg))
+        return false;
+
+    // the loaded text is what save would write for this pixmap.
+    auto it= std::find_if(m_data.begin(), m_data.end(), [imgKey](const ImageInfo& info) { return info.key == imgKey; });
+    if(it != m_data.end())
+        it->encoded= encoded;
+    return true;
 }
 
 /*
@@ -198,6 +272,8 @@ bool ImageModel::insertImage(const QPixmap& pix, const QString& key, const QStri
         it->pixmap= pix;
         it->filename= filename;
         it->isBackground= isBg;
+        it->toolTip.clear();
+        it->encoded.clear();
         emit internalDataChanged();
         return true;
     }
@@ -277,6 +353,8 @@ void ImageModel::setPathFor(const QModelIndex& idx, const QString& path)
         return;
     }
     info.pixmap= pix;
+    info.toolTip.clear();
+    info.encoded.clear();
     emit dataChanged(idx, idx, QVector<int>() << Qt::DisplayRole);
 }
 
@@ -0,0 +1,89 @@
+#ifndef CHARACTERSHEET_CHANGEJOURNAL_H
+#define CHARACTERSHEET_CHANGEJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QJsonObject>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+
+#include <charactersheet/charactersheet_global.h>
+
+class CharacterSheet;
+class CharacterSheetItem;
+class CharacterSheetModel;
+
+/**
+ * @brief The ChangeJournal class appends each field edition of the model to a file next to the .rcs file.
+ * Records are written in batches and synced to disk on a worker thread, so an autosave costs the size of the
+ * editions only.
+ * On open, the .rcs file is loaded first, then replay applies the journal and compact writes a new .rcs file
+ * in the background and drops the records it contains.
+ */
+class CHARACTERSHEET_EXPORT ChangeJournal : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChangeJournal(CharacterSheetModel* model, QObject* parent= nullptr);
+    ~ChangeJournal() override;
+
+    static QString journalPath(const QString& rcsPath);
+
+    /**
+     * @brief open opens (or creates) the journal of the given .rcs file and starts to record editions.
+     */
+    bool open(const QString& rcsPath);
+    void close();
+    bool isOpen() const;
+    /**
+     * @brief replay applies the records of the journal to the model, it returns how many have been applied.
+     * A record cut by a crash ends the journal, it is removed.
+     */
+    int replay();
+    /**
+     * @brief compact writes the snapshot as the new .rcs file on a worker thread, records written before the call
+     * are then removed from the journal. The snapshot must contain all editions recorded so far.
+     * If a compaction is running, its future is returned. Nothing is removed if the journal has been closed or
+     * opened again meanwhile.
+     */
+    QFuture<bool> compact(const QJsonObject& snapshot);
+    /**
+     * @brief flush writes the pending records to the file, they are synced to disk on a worker thread.
+     * close waits for the sync.
+     */
+    bool flush();
+    /**
+     * @brief setFlushInterval sets the maximum time in ms a record waits before being written, 1000 by default.
+     */
+    void setFlushInterval(int msec);
+    int flushInterval() const;
+
+    QString errorString() const;
+
+private:
+    void record(CharacterSheet* sheet, CharacterSheetItem* item, const QString& parent);
+    void dropUntil(const QString& fileName, quint64 generation, qint64 offset);
+    void syncLater();
+    bool setError(const QString& error);
+
+private:
+    QPointer<CharacterSheetModel> m_model;
+    QFile m_file;
+    QString m_rcsPath;
+    QByteArray m_pending;
+    QTimer m_flushTimer;
+    QFuture<bool> m_compaction;
+    QFuture<bool> m_sync;
+    bool m_syncAgain= false;
+    /**
+     * @brief incremented each time the journal is opened or closed.
+     */
+    quint64 m_generation= 0;
+    QString m_error;
+    bool m_replaying= false;
+};
+
+#endif // CHARACTERSHEET_CHANGEJOURNAL_H
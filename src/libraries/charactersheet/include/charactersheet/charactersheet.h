@@ -20,6 +20,9 @@
 
 #ifndef CHARACTERSHEET_H
 #define CHARACTERSHEET_H
+#include <QCborArray>
+#include <QCborStreamWriter>
+#include <QHash>
 #include <QMap>
 #include <QString>
 #include <QVariant>
@@ -29,8 +32,11 @@
 //#include "field.h"
 
 #include <charactersheet/charactersheetitem.h>
+#include <charactersheet/fieldvalue.h>
 
 class Section;
+struct CharacterRecord;
+struct TableRecord;
 /**
  * @brief the characterSheet stores Section as many as necessary
  */
@@ -52,7 +58,7 @@ public:
      */
     const QString getkey(int index);
     /**
-     * @brief save
+     * @brief save writes the character, values are serialized again only if a field has changed since last save.
      * @param json
      */
     virtual void save(QJsonObject& json) const;
@@ -61,6 +67,32 @@ public:
      * @param json
      */
     virtual void load(const QJsonObject& json);
+    /**
+     * @brief save writes the character as [name, uuid, values, extras]. Values follow the order of the children
+     * of the schema, fields unknown to the schema are written in extras by key.
+     */
+    void save(QCborStreamWriter& writer, const Section* schema) const;
+    /**
+     * @brief load reads a character written by save, keys give the field id of each position of values.
+     */
+    void load(const QCborArray& array, const QStringList& keys, const Section* schema);
+    /**
+     * @brief load builds the fields from a decoded record, labels and types it does not hold come from schema.
+     */
+    void load(const CharacterRecord& record, const Section* schema);
+    /**
+     * @brief snapshot copies the data of the character, the record can then be serialized on another thread.
+     * Tables are written at once as their lines only live in items.
+     */
+    CharacterRecord snapshot() const;
+    /**
+     * @brief isSaveCached tells if save would reuse the values written last time.
+     */
+    bool isSaveCached() const;
+    /**
+     * @brief setSaveCache gives the values written from a snapshot, they are reused until a field changes.
+     */
+    void setSaveCache(const QJsonObject& json) const;
 
     /**
      * @brief getTitle
@@ -103,6 +135,38 @@ public:
     QHash<QString, QString> getVariableDictionnary();
 
     void insertCharacterItem(CharacterSheetItem* item);
+    /**
+     * @brief insertFieldValue adds a field without creating its item.
+     */
+    void insertFieldValue(const FieldValue& value);
+    /**
+     * @brief updateFieldSchema gives the type and the label of the structure item to the matching field.
+     */
+    void updateFieldSchema(const CharacterSheetItem* schema);
+    /**
+     * @brief fieldValue gives a copy of the field data, no item is created.
+     */
+    FieldValue fieldValue(const QString& key) const;
+    /**
+     * @brief existingItem gives the item of the field only if it has already been created.
+     */
+    CharacterSheetItem* existingItem(const QString& key) const;
+    bool hasField(const QString& key) const;
+    QStringList fieldKeys() const;
+    /**
+     * @brief acquireItems creates items for all fields. They are kept until the matching releaseItems.
+     */
+    void acquireItems();
+    /**
+     * @brief releaseItems turns items of simple fields back into FieldValue once the sheet is no longer bound.
+     * Items got through getFieldFromKey or getFieldAt are deleted later, they are not recycled for other fields.
+     * Items built while the sheet is not bound are released the same way when the event loop runs again.
+     */
+    void releaseItems();
+    /**
+     * @brief isBound tells if items of the sheet are in use (acquireItems has been called).
+     */
+    bool isBound() const;
 
     QString uuid() const;
     void setUuid(const QString& uuid);
@@ -132,15 +196,46 @@ signals:
     void addLineToTableField(CharacterSheet*, CharacterSheetItem*);
     void uuidChanged();
     void nameChanged();
+    void itemsReleased();
+    /**
+     * @brief tableLinesChanged is emitted when lines of a table are added, removed or reloaded.
+     */
+    void tableLinesChanged(CharacterSheet* sheet, CharacterSheetItem* table);
+    /**
+     * @brief tableCellsChanged is emitted when cells of fetched lines are changed by the table (computed columns).
+     */
+    void tableCellsChanged(CharacterSheet* sheet, CharacterSheetItem* table, int firstLine, int lastLine);
+    /**
+     * @brief tableCellsReleased is emitted when lines of a table go back to plain values, their cells are deleted.
+     */
+    void tableCellsReleased(CharacterSheet* sheet, CharacterSheetItem* table);
 
 protected:
     void insertField(QString key, CharacterSheetItem* itemSheet);
 
 private:
     QStringList explosePath(QString);
+    CharacterSheetItem* itemFromKey(const QString& key) const;
+    CharacterSheetItem* createItem(const QString& key);
+    void releaseFieldItems();
+    void scheduleRelease();
+    void insertTable(const TableRecord& record);
+    void writeCborField(QCborStreamWriter& writer, const QString& key, const CharacterSheetItem* schemaItem) const;
 
 private:
+    /**
+     * @brief all fields of the character, value is null while the field only lives in m_plainValues.
+     */
     QMap<QString, CharacterSheetItem*> m_valuesMap;
+    QHash<QString, FieldValue> m_plainValues;
+    /**
+     * @brief values written by the last save, they are used again until a field changes.
+     */
+    mutable QJsonObject m_savedValues;
+    mutable bool m_saveCacheValid= false;
+    int m_bindCount= 0;
+    bool m_releaseScheduled= false;
+    Section* m_origin= nullptr;
     /**
      *@brief User Id of the owner
      */
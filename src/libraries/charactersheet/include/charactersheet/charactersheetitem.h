@@ -283,6 +283,10 @@ signals:
     void idChanged();
     void labelChanged();
     void characterSheetItemChanged(CharacterSheetItem* item);
+    /**
+     * @brief dataItemChanged is emitted by every setter of a data written by saveDataItem, whatever its origin.
+     */
+    void dataItemChanged();
 
 protected:
     CharacterSheetItem* m_parent;
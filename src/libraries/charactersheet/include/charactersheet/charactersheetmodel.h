@@ -22,10 +22,22 @@
 #define CHARACTERSHEETMODEL_H
 
 #include <QAbstractItemModel>
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
 
 #include <QFile>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMap>
+#include <QPair>
 #include <QPointF>
+#include <QPointer>
+#include <QSet>
 #include <QTextStream>
+#include <QTimer>
+#include <QUuid>
+#include <functional>
 
 #include <charactersheet/charactersheet_global.h>
 
@@ -33,6 +45,8 @@
 
 class CharacterSheet;
 class Section;
+class CharacterStore;
+struct CharacterRecord;
 
 namespace Formula
 {
@@ -90,6 +104,7 @@ public:
      * @param role : the data role.
      */
     QVariant data(const QModelIndex& index, int role= Qt::DisplayRole) const;
+    void multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const override;
     /**
      * @brief allows editing. The model can modify the data beacause of the function.
      * @param index : location of the amended data.
@@ -117,12 +132,59 @@ public:
     CharacterSheetItem* indexToSection(const QModelIndex& index);
     QModelIndex indexToSectionIndex(const QModelIndex& index);
 
+    /**
+     * @brief getCharacterSheet builds the character if needed, it is not evicted before the event loop runs again.
+     * Callers keeping it longer bind it or listen to characterSheetEvicted, emitted before it is deleted.
+     */
     CharacterSheet* getCharacterSheet(int id);
 
     // QList<CharacterSheetItem *>* getExportedList(CharacterSheet*);
 
-    bool writeModel(QJsonObject& file, bool data= true);
+    /**
+     * @brief writeModel writes the model as json. When parallel is true, changed characters are copied and then
+     * serialized on the thread pool, the array keeps the order of the model. A progressive load is finished
+     * first, the characters still decoded by the workers are inserted before writing.
+     */
+    bool writeModel(QJsonObject& file, bool data= true, bool parallel= false);
     void readModel(const QJsonObject& file, bool readRootSection);
+    /**
+     * @brief readModelAsync decodes the characters on worker threads and returns at once. The model is reset and
+     * filled on its own thread when all of them are decoded. Progress of the future counts decoded characters.
+     * When progressive is true, the structure and the first characters are loaded before returning, the others
+     * are inserted as columns while they are decoded. A new load or clearModel cancels the pending one, writing
+     * the model waits for it.
+     */
+    QFuture<void> readModelAsync(const QJsonObject& file, bool readRootSection, bool progressive= false);
+    /**
+     * @brief writeModel writes the binary form of the model, see readModel. It waits for a pending load too.
+     */
+    bool writeModel(QCborStreamWriter& writer, bool data= true);
+    /**
+     * @brief readModel reads a CBOR map with integer keys: version, structure, field ids and characters.
+     * Characters store their values by position in the field ids list.
+     */
+    bool readModel(QCborStreamReader& reader, bool readRootSection);
+    /**
+     * @brief beginLoading starts a reset of the model, the structure and the characters are then given one by one
+     * to loadRootSection and loadCharacter, in any order. endLoading must be called at the end.
+     */
+    void beginLoading();
+    void loadRootSection(const QJsonObject& data);
+    CharacterSheet* loadCharacter(const QJsonObject& json);
+    /**
+     * @brief loadCharacterLater keeps the json of the character, it is built the first time it is requested.
+     * It must be called between beginLoading and endLoading.
+     */
+    void loadCharacterLater(const QByteArray& json);
+    void endLoading();
+    /**
+     * @brief setMemoryBudget bounds the size of the characters kept in memory, 0 (default) means no limit.
+     * Beyond it, least recently used characters which are neither modified nor bound are written to a cache
+     * file and deleted, characterSheetEvicted is emitted before. They are built again on next access.
+     * Characters modified since they were built are only evicted after the model has been written.
+     */
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
     void setRootSection(const QJsonObject& file);
     QJsonObject rootSectionData() const;
 
@@ -135,7 +197,15 @@ public:
 
     void addCharacterSheet(CharacterSheet* sheet, int pos);
 
+    /**
+     * @brief getCharacterSheetById finds a character from its uuid, it is kept like with getCharacterSheet.
+     */
     CharacterSheet* getCharacterSheetById(QString id);
+    /**
+     * @brief setFieldData updates one field of a character as a change coming from network, parent is the path
+     * of the table for a cell.
+     */
+    bool setFieldData(const QString& uuid, const QJsonObject& data, const QString& parent);
 
     int getCharacterSheetCount() const;
 
@@ -150,26 +220,136 @@ public slots:
 
     void checkCharacter(Section* section);
     void addSubChildRoot(CharacterSheetItem* item);
-    void fieldHasBeenChanged(CharacterSheet* sheet, CharacterSheetItem* item, const QString&);
+    void fieldHasBeenChanged(CharacterSheet* sheet, CharacterSheetItem* item, const QString& path);
     void addSubChild(CharacterSheet* sheet, CharacterSheetItem* item);
+    /**
+     * @brief insertLines adds count lines at pos into the table of the sheet, views are notified once.
+     */
+    void insertLines(CharacterSheet* sheet, CharacterSheetItem* item, int pos, int count);
+    void removeLines(CharacterSheet* sheet, CharacterSheetItem* item, int first, int last);
 
 signals:
     void characterSheetHasBeenAdded(CharacterSheet* sheet);
+    void characterSheetEvicted(CharacterSheet* sheet);
     void dataCharacterChange();
+    /**
+     * @brief fieldChanged is emitted when a field of a character is edited, parent is the path of its table if any.
+     */
+    void fieldChanged(CharacterSheet* sheet, CharacterSheetItem* item, const QString& parent);
 
 protected:
     void computeFormula(QString path, CharacterSheet* sheet);
 
 private:
+    /**
+     * @brief The CellContext struct gathers what is needed to answer any role of a cell.
+     */
+    struct CellContext
+    {
+        CharacterSheetItem* item= nullptr;
+        CharacterSheet* sheet= nullptr;
+        CharacterSheetItem* tableCell= nullptr;
+        QString path;
+        int column= 0;
+        bool inTable= false;
+    };
+    static bool isCellRole(int role);
+    CellContext resolveCell(const QModelIndex& index) const;
+    QVariant cellData(const CellContext& cell, int role) const;
     void checkTableItem();
+    void connectSheet(CharacterSheet* sheet);
+    /**
+     * @brief pathOf caches the path of structure items, it is the key of character fields.
+     */
+    QString pathOf(CharacterSheetItem* item) const;
+    /**
+     * @brief tableCell gives the cell of the sheet matching the structure cell, results are cached.
+     */
+    CharacterSheetItem* tableCell(CharacterSheetItem* structureCell, int row, CharacterSheet* sheet) const;
+    void invalidateCellCache() const;
+    static const QList<int>& labelRoles();
+    static const QList<int>& valueRoles();
+    /**
+     * @brief fieldRoles are the roles of a field which may have changed any of its data, read-only state included.
+     */
+    static const QList<int>& fieldRoles();
+    /**
+     * @brief markChanged records the changed roles of a cell, dataChanged is emitted for all of them at the next event
+     * loop or before the model moves or removes rows and columns.
+     */
+    void markChanged(CharacterSheetItem* parent, int row, int column, const QList<int>& roles);
+    void markFieldChanged(CharacterSheet* sheet, const QString& path, const QList<int>& roles);
+    void markTableCellChanged(CharacterSheet* sheet, const QString& tablePath, CharacterSheetItem* cell,
+                              const QList<int>& roles);
+    void markTableLinesChanged(CharacterSheet* sheet, CharacterSheetItem* table, int firstLine, int lastLine);
+    /**
+     * @brief notifyFormulaOnlyEdit emits fieldChanged when an edit changed the formula of the item but not its value.
+     */
+    void notifyFormulaOnlyEdit(CharacterSheet* sheet, CharacterSheetItem* item, const QString& previousValue,
+                               const QString& previousFormula);
+    void emitPendingChanges();
+    /**
+     * @brief maxTableChildCount gives the cell count of the longest table of the characters, kept in cache.
+     */
+    int maxTableChildCount(const QString& key) const;
+    void updateTableChildCount(CharacterSheetItem* table);
+    /**
+     * @brief mergeRootSection turns the current structure into the given one with row signals, views keep their state.
+     * The previous root section is left to its owner, holding the items which are not used anymore.
+     */
+    void mergeRootSection(Section* rootSection);
+    void reservePools(int characterCount);
+    void appendLoadedSheet(CharacterSheet* sheet);
+    void loadRecords(const QList<CharacterRecord>& records);
+    void insertRecords(const QList<CharacterRecord>& records);
+    void insertTableRows(CharacterSheet* sheet);
+    void cancelPendingLoad();
+    void finishPendingLoad();
+    CharacterSheet* materializeCharacter(const QByteArray& json);
+    /**
+     * @brief syncCharacter tells views about the table lines of a character built on demand.
+     */
+    void syncCharacter(CharacterSheet* sheet);
+    bool canReleaseCharacter(CharacterSheet* sheet) const;
+    void releaseCharacter(CharacterSheet* sheet);
+    /**
+     * @brief handOut keeps a character given to a caller in memory until the event loop runs again.
+     */
+    void handOut(CharacterSheet* sheet);
+    /**
+     * @brief indexSheet keeps the uuid index in sync with the uuid of the sheet.
+     */
+    void indexSheet(CharacterSheet* sheet);
+    void unindexSheet(CharacterSheet* sheet);
+    CharacterSheet* findCharacterSheet(const QString& id);
 
 private:
     /**
-     * @brief QList which stores pointer to CharacterSheet.
+     * @brief characters by column, some of them may not be built yet.
      */
-    QList<CharacterSheet*>* m_characterList= nullptr;
+    CharacterStore* m_characterList= nullptr;
     Section* m_rootSection= nullptr;
     Formula::FormulaManager* m_formulaManager= nullptr;
+    mutable QHash<const CharacterSheetItem*, QString> m_pathCache;
+    mutable QHash<QPair<const CharacterSheetItem*, const CharacterSheet*>, CharacterSheetItem*> m_tableCellCache;
+    mutable QHash<QString, int> m_tableChildCounts;
+    QHash<QPair<CharacterSheetItem*, int>, QMap<int, QList<int>>> m_changedCells;
+    QTimer m_changeTimer;
+    QHash<QUuid, QPointer<CharacterSheet>> m_sheetByUuid;
+    QSet<CharacterSheet*> m_unsyncedSheets;
+    /**
+     * @brief characters given to callers since the event loop last ran, they are not evicted.
+     */
+    QSet<const CharacterSheet*> m_handedOutSheets;
+    /**
+     * @brief cell count of the longest table of the evicted characters, their rows are kept.
+     */
+    QHash<QString, int> m_evictedTableChildCounts;
+    QPointer<QFutureWatcherBase> m_pendingLoad;
+    /**
+     * @brief completes the pending load on this thread once its future is finished.
+     */
+    std::function<void()> m_completeLoad;
 };
 
 #endif // CHARACTERSHEETMODEL_H
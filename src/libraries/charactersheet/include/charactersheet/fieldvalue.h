@@ -0,0 +1,67 @@
+#ifndef CHARACTERSHEET_FIELDVALUE_H
+#define CHARACTERSHEET_FIELDVALUE_H
+
+#include <QCborMap>
+#include <QCborStreamWriter>
+#include <QJsonObject>
+#include <QString>
+
+#include <charactersheet/charactersheet_global.h>
+#include <charactersheet/charactersheetitem.h>
+
+/**
+ * @brief The FieldValue struct stores the data of one character field without any QObject.
+ * CharacterSheet keeps its fields as FieldValue until an item is required (binding, edition…).
+ */
+struct CHARACTERSHEET_EXPORT FieldValue
+{
+    /**
+     * @brief The CborKey enum lists the integer keys of the binary record of a field.
+     */
+    enum CborKey
+    {
+        CborValueKey= 0,
+        CborFormulaKey,
+        CborReadOnlyKey,
+        CborLabelKey,
+        CborTypeFieldKey,
+        CborTypeKey,
+        CborTableKey
+    };
+
+    QString id;
+    QString label;
+    QString value;
+    QString formula;
+    QString type= QStringLiteral("field");
+    CharacterSheetItem::TypeField typeField= CharacterSheetItem::TEXTINPUT;
+    bool readOnly= false;
+
+    /**
+     * @brief fromJson reads the same keys as FieldController::loadDataItem.
+     */
+    static FieldValue fromJson(const QJsonObject& json);
+    /**
+     * @brief fromItem makes a snapshot of the data of the given item.
+     */
+    static FieldValue fromItem(const CharacterSheetItem* item);
+    /**
+     * @brief toJson writes the same keys as FieldController::saveDataItem.
+     */
+    void toJson(QJsonObject& json) const;
+    /**
+     * @brief fromCbor reads a record written by toCbor, missing label and typefield come from the schema item.
+     */
+    static FieldValue fromCbor(const QCborMap& map, const QString& id, const CharacterSheetItem* schema);
+    /**
+     * @brief toCbor writes an integer keyed record. Label and typefield are skipped when they match the schema
+     * item, the id is not written: it is given by the position of the record.
+     */
+    void toCbor(QCborStreamWriter& writer, const CharacterSheetItem* schema) const;
+    /**
+     * @brief applyTo copies the data into the item, the item is considered as updated from network.
+     */
+    void applyTo(CharacterSheetItem* item) const;
+};
+
+#endif // CHARACTERSHEET_FIELDVALUE_H
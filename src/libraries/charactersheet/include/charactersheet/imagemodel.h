@@ -35,6 +35,8 @@ public:
         bool isBackground;
         QString filename;
         QString key;
+        mutable QString toolTip; // built on first request
+        mutable QString encoded; // base64 PNG written by save, cleared when the pixmap changes
     };
     explicit ImageModel(QObject* parent= nullptr);
 
@@ -46,6 +48,14 @@ public:
     int columnCount(const QModelIndex& parent= QModelIndex()) const override;
 
     QVariant data(const QModelIndex& index, int role= Qt::DisplayRole) const override;
+    /**
+     * @brief multiData only renders the tooltip when it is the single role asked for, as a view does on hover.
+     */
+    void multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const override;
+    /**
+     * @brief roleNames leaves the tooltip out, QML delegates would render every thumbnail otherwise.
+     */
+    QHash<int, QByteArray> roleNames() const override;
     bool setData(const QModelIndex& index, const QVariant& value, int role) override;
 
     bool insertImage(const QPixmap& pix, const QString& key, const QString& path, bool isBg);
@@ -53,8 +63,16 @@ public:
 
     void clear();
 
-    void save(QJsonArray& array) const;
+    /**
+     * @brief save writes images as base64 PNG. Only images changed since last save are encoded, on the thread pool
+     * when parallel is true.
+     */
+    void save(QJsonArray& array, bool parallel= false) const;
     void load(const QJsonArray& array);
+    /**
+     * @brief loadImage adds one image of the json array written by save.
+     */
+    bool loadImage(const QJsonObject& imgInfo);
 
     void removeImageAt(const QModelIndex& index);
     void setPathFor(const QModelIndex& index, const QString& path);
@@ -71,6 +89,10 @@ signals:
     void backgroundSizeChanged();
     void internalDataChanged();
 
+private:
+    QVariant toolTip(const ImageInfo& info) const;
+    QVariant infoData(const ImageInfo& info, int col, int role) const;
+
 private:
     QStringList m_column;
     std::vector<ImageInfo> m_data;
@@ -0,0 +1,63 @@
+#ifndef CHARACTERSHEET_RCSSTREAMREADER_H
+#define CHARACTERSHEET_RCSSTREAMREADER_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <functional>
+
+#include <charactersheet/charactersheet_global.h>
+
+class QIODevice;
+class CharacterSheetModel;
+namespace charactersheet
+{
+class ImageModel;
+}
+
+/**
+ * @brief The RcsStreamReader class loads a .rcs file without building the json document of the whole file.
+ * The top level object is walked incrementally: the structure, each character and each background image are
+ * parsed on their own as soon as their text is complete, then dropped.
+ */
+class CHARACTERSHEET_EXPORT RcsStreamReader
+{
+public:
+    explicit RcsStreamReader(QIODevice* device);
+
+    /**
+     * @brief read fills the model and the image model, images may be null to skip them.
+     */
+    bool read(CharacterSheetModel* model, charactersheet::ImageModel* images, bool readRootSection= true);
+    /**
+     * @brief otherValues gives the top level values which are not handled by the reader (qml, fonts…).
+     */
+    QJsonObject otherValues() const;
+    QString errorString() const;
+    /**
+     * @brief setIndexedCharacters makes read keep the json of each character, characters are built on first access.
+     */
+    void setIndexedCharacters(bool indexed);
+
+private:
+    bool fill();
+    bool skipSpaces();
+    bool expect(char c);
+    bool readKey(QString& key);
+    bool readValue(QByteArray& raw);
+    bool readArray(const std::function<bool(const QByteArray&)>& readElement);
+    bool setError(const QString& error);
+
+    static QJsonValue parseValue(const QByteArray& raw);
+
+private:
+    QIODevice* m_device= nullptr;
+    QByteArray m_buffer;
+    qsizetype m_pos= 0;
+    QJsonObject m_otherValues;
+    QString m_error;
+    bool m_indexedCharacters= false;
+};
+
+#endif // CHARACTERSHEET_RCSSTREAMREADER_H
@@ -3,6 +3,7 @@
 
 #include <QMouseEvent>
 #include <QPointF>
+#include <QPointer>
 #include <QQuickWidget>
 
 #include <charactersheet/widget/charactersheet_widget_global.h>
@@ -14,6 +15,7 @@ class CHARACTERSHEET_WIDGET_EXPORT SheetWidget : public QQuickWidget
     Q_PROPERTY(CharacterSheet* sheet READ sheet WRITE setSheet NOTIFY sheetChanged)
 public:
     SheetWidget(QWidget* parent= nullptr);
+    virtual ~SheetWidget();
 
     void setSheet(CharacterSheet* sheet);
     CharacterSheet* sheet() const;
@@ -26,7 +28,7 @@ protected:
     virtual void mousePressEvent(QMouseEvent* event);
 
 private:
-    CharacterSheet* m_characterSheet;
+    QPointer<CharacterSheet> m_characterSheet;
 };
 
 #endif // SHEETWIDGET_H
@@ -0,0 +1,70 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <QList>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <functional>
+
+/**
+ * @brief The ObjectPool class builds QObjects by batch ahead of the bulk loads which need them.
+ * Objects are not recycled: views and callers may still reference a released object, it is deleted later instead.
+ * Pools are meant to be used from the GUI thread only. setCapacity(0) empties the pool, pools are drained that way
+ * when the application is destroyed.
+ */
+template <typename T>
+class ObjectPool
+{
+public:
+    explicit ObjectPool(std::function<T*()> factory, int capacity= 4096)
+        : m_factory(std::move(factory)), m_capacity(capacity)
+    {
+    }
+    ~ObjectPool() { qDeleteAll(m_free); }
+
+    ObjectPool(const ObjectPool&)= delete;
+    ObjectPool& operator=(const ObjectPool&)= delete;
+
+    T* acquire()
+    {
+        if(m_free.isEmpty())
+            return m_factory();
+        return m_free.takeLast();
+    }
+
+    /**
+     * @brief reserve builds objects in one batch until count of them are available (bounded by the capacity).
+     */
+    void reserve(int count)
+    {
+        count= std::min(count, m_capacity);
+        if(m_free.size() >= count)
+            return;
+
+        m_free.reserve(count);
+        while(m_free.size() < count)
+            m_free.append(m_factory());
+    }
+
+    void clear()
+    {
+        qDeleteAll(m_free);
+        m_free.clear();
+    }
+
+    int available() const { return m_free.size(); }
+    int capacity() const { return m_capacity; }
+    void setCapacity(int capacity)
+    {
+        m_capacity= std::max(0, capacity);
+        while(m_free.size() > m_capacity)
+            delete m_free.takeLast();
+    }
+
+private:
+    std::function<T*()> m_factory;
+    QList<T*> m_free;
+    int m_capacity;
+};
+
+#endif // OBJECTPOOL_H
@@ -0,0 +1,274 @@
+#include "charactersheet/rcsstreamreader.h"
+
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "charactersheet/charactersheetmodel.h"
+#include "charactersheet/imagemodel.h"
+
+namespace
+{
+constexpr qint64 chunkSize= 64 * 1024;
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+} // namespace
+
+RcsStreamReader::RcsStreamReader(QIODevice* device) : m_device(device) {}
+
+bool RcsStreamReader::read(CharacterSheetModel* model, charactersheet::ImageModel* images, bool readRootSection)
+{
+    if(nullptr == m_device || nullptr == model)
+        return setError(QStringLiteral("no device or no model"));
+
+    if(!expect('{'))
+        return false;
+
+    model->beginLoading();
+    bool ok= skipSpaces();
+    if(ok && m_buffer.at(m_pos) == '}')
+        ++m_pos;
+    else
+    {
+        while(ok)
+        {
+            QString key;
+            ok= readKey(key) && expect(':');
+            if(!ok)
+                break;
+
+            if(key == QStringLiteral("characters"))
+            {
+                ok= readArray(
+                    [this, model](const QByteArray& raw)
+                    {
+                        if(m_indexedCharacters)
+                            model->loadCharacterLater(raw);
+                        else
+                            model->loadCharacter(QJsonDocument::fromJson(raw).object());
+                        return true;
+                    });
+            }
+            else if(key == QStringLiteral("background"))
+            {
+                // images are decoded one by one, only the current one is held in memory.
+                ok= readArray(
+                    [images](const QByteArray& raw)
+                    {
+                        if(nullptr != images)
+                            images->loadImage(QJsonDocument::fromJson(raw).object());
+                        return true;
+                    });
+            }
+            else
+            {
+                QByteArray raw;
+                ok= readValue(raw);
+                if(ok && key == QStringLiteral("data"))
+                {
+                    if(readRootSection)
+                        model->loadRootSection(QJsonDocument::fromJson(raw).object());
+                }
+                else if(ok)
+                    m_otherValues.insert(key, parseValue(raw));
+            }
+
+            ok= ok && skipSpaces();
+            if(!ok)
+                break;
+            auto const c= m_buffer.at(m_pos++);
+            if(c == '}')
+                break;
+            if(c != ',')
+                ok= setError(QStringLiteral("',' or '}' expected"));
+        }
+    }
+    model->endLoading();
+    return ok;
+}
+
+QJsonObject RcsStreamReader::otherValues() const
+{
+    return m_otherValues;
+}
+
+QString RcsStreamReader::errorString() const
+{
+    return m_error;
+}
+
+void RcsStreamReader::setIndexedCharacters(bool indexed)
+{
+    m_indexedCharacters= indexed;
+}
+
+bool RcsStreamReader::fill()
+{
+    // consumed bytes are dropped, the buffer only holds the value being read.
+    if(m_pos > 0)
+    {
+        m_buffer.remove(0, m_pos);
+        m_pos= 0;
+    }
+    auto const chunk= m_device->read(chunkSize);
+    if(chunk.isEmpty())
+        return false;
+    m_buffer.append(chunk);
+    return true;
+}
+
+bool RcsStreamReader::skipSpaces()
+{
+    forever
+    {
+        while(m_pos < m_buffer.size() && isSpace(m_buffer.at(m_pos)))
+            ++m_pos;
+        if(m_pos < m_buffer.size())
+            return true;
+        if(!fill())
+            return setError(QStringLiteral("unexpected end of file"));
+    }
+}
+
+bool RcsStreamReader::expect(char c)
+{
+    if(!skipSpaces())
+        return false;
+    if(m_buffer.at(m_pos) != c)
+        return setError(QStringLiteral("'%1' expected").arg(QChar::fromLatin1(c)));
+    ++m_pos;
+    return true;
+}
+
+bool RcsStreamReader::readKey(QString& key)
+{
+    QByteArray raw;
+    if(!readValue(raw) || !raw.startsWith('"'))
+        return setError(QStringLiteral("key expected"));
+    key= parseValue(raw).toString();
+    return true;
+}
+
+bool RcsStreamReader::readValue(QByteArray& raw)
+{
+    if(!skipSpaces())
+        return false;
+
+    int depth= 0;
+    bool inString= false;
+    forever
+    {
+        if(m_pos >= m_buffer.size() && !fill())
+        {
+            // a number or a literal may end the file.
+            if(depth == 0 && !inString && !raw.isEmpty())
+                return true;
+            return setError(QStringLiteral("unexpected end of file"));
+        }
+
+        if(inString)
+        {
+            // strings (base64 images) are copied by spans up to the next quote or escape.
+            auto end= m_pos;
+            while(end < m_buffer.size() && m_buffer.at(end) != '"' && m_buffer.at(end) != '\\')
+                ++end;
+            raw.append(m_buffer.constData() + m_pos, end - m_pos);
+            m_pos= end;
+            if(m_pos >= m_buffer.size())
+                continue;
+
+            if(m_buffer.at(m_pos) == '\\')
+            {
+                if(m_pos + 1 >= m_buffer.size() && !fill())
+                    return setError(QStringLiteral("unexpected end of file"));
+                raw.append(m_buffer.constData() + m_pos, 2);
+                m_pos+= 2;
+                continue;
+            }
+            raw.append('"');
+            ++m_pos;
+            inString= false;
+            if(depth == 0)
+                return true;
+            continue;
+        }
+
+        auto const c= m_buffer.at(m_pos);
+        switch(c)
+        {
+        case '"':
+            inString= true;
+            break;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if(depth == 0)
+                return !raw.isEmpty() || setError(QStringLiteral("value expected"));
+            --depth;
+            if(depth == 0)
+            {
+                raw.append(c);
+                ++m_pos;
+                return true;
+            }
+            break;
+        case ',':
+        case ':':
+            if(depth == 0)
+                return !raw.isEmpty() || setError(QStringLiteral("value expected"));
+            break;
+        default:
+            if(depth == 0 && isSpace(c))
+                return true;
+            break;
+        }
+        raw.append(c);
+        ++m_pos;
+    }
+}
+
+bool RcsStreamReader::readArray(const std::function<bool(const QByteArray&)>& readElement)
+{
+    if(!expect('['))
+        return false;
+    if(!skipSpaces())
+        return false;
+    if(m_buffer.at(m_pos) == ']')
+    {
+        ++m_pos;
+        return true;
+    }
+
+    forever
+    {
+        QByteArray raw;
+        if(!readValue(raw) || !readElement(raw) || !skipSpaces())
+            return false;
+
+        auto const c= m_buffer.at(m_pos++);
+        if(c == ']')
+            return true;
+        if(c != ',')
+            return setError(QStringLiteral("',' or ']' expected"));
+    }
+}
+
+bool RcsStreamReader::setError(const QString& error)
+{
+    if(m_error.isEmpty())
+        m_error= error;
+    return false;
+}
+
+QJsonValue RcsStreamReader::parseValue(const QByteArray& raw)
+{
+    // scalars are not valid documents, they are read inside an array.
+    auto const doc= QJsonDocument::fromJson(QByteArray("[").append(raw).append(']'));
+    return doc.array().at(0);
+}
@@ -23,6 +23,7 @@
 #include <QGraphicsScene>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QSet>
 
 #include "field.h"
 #include "tablefield.h"
@@ -297,52 +298,77 @@ void Section::changeKeyChild(QString oldkey, QString newKey, CharacterSheetItem*
 }
 void Section::buildDataInto(CharacterSheet* character)
 {
-    QStringList ids;
+    QSet<QString> ids;
+    ids.reserve(getChildrenCount());
     for(int i= 0; i < getChildrenCount(); ++i)
     {
         CharacterSheetItem* childItem= getChildAt(i);
+        if(nullptr == childItem)
+            continue;
+
         auto path= childItem->getPath();
-        auto field= character->getFieldFromKey(path);
-        ids << childItem->getId();
-        if(nullptr != childItem && nullptr == field)
+        ids.insert(childItem->getId());
+        if(!character->hasField(path))
         {
-            CharacterSheetItem* newItem= nullptr;
-            if(CharacterSheetItem::FieldItem == childItem->getItemType())
-            {
-                auto newField= new FieldController(false);
-                newField->copyField(childItem, false);
-                newItem= newField;
-            }
-            else if(CharacterSheetItem::TableItem == childItem->getItemType())
-            {
-                TableField* tablefield= new TableField(false);
-                tablefield->copyField(childItem, false);
-                newItem= tablefield;
-            }
-
-            if(nullptr != newItem)
-            {
-                newItem->setValue(character->getValue(newItem->getId()).toString());
-                character->insertCharacterItem(newItem);
-            }
             if(CharacterSheetItem::SectionItem == childItem->getItemType())
             {
                 Section* sec= dynamic_cast<Section*>(childItem);
                 sec->buildDataInto(character);
             }
+            else
+            {
+                buildItemInto(character, childItem);
+            }
         }
     }
 
-    for(int i= character->getFieldCount() - 1; i >= 0; --i)
+    auto const& keys= character->fieldKeys();
+    for(auto const& id : keys)
     {
-        auto child= character->getFieldAt(i);
-        auto id= child->getId();
         if(!ids.contains(id))
         {
             character->removeField(id);
         }
     }
 }
+
+void Section::buildItemInto(CharacterSheet* character, CharacterSheetItem* childItem)
+{
+    if(nullptr == character || nullptr == childItem)
+        return;
+
+    if(CharacterSheetItem::FieldItem == childItem->getItemType())
+    {
+        // simple fields get their item on demand.
+        auto value= FieldValue::fromItem(childItem);
+        value.value= character->getValue(value.id).toString();
+        value.readOnly= false;
+        character->insertFieldValue(value);
+    }
+    else if(CharacterSheetItem::TableItem == childItem->getItemType())
+    {
+        TableField* tablefield= new TableField(false);
+        tablefield->copyField(childItem, false);
+        tablefield->setValue(character->getValue(tablefield->getId()).toString());
+        character->insertCharacterItem(tablefield);
+    }
+}
+
+CharacterSheetItem* Section::takeChildAt(int pos)
+{
+    if(pos < 0 || pos >= m_keyList.size())
+        return nullptr;
+
+    return m_dataHash.take(m_keyList.takeAt(pos));
+}
+
+void Section::moveChild(int from, int to)
+{
+    if(from < 0 || from >= m_keyList.size() || to < 0 || to >= m_keyList.size())
+        return;
+
+    m_keyList.move(from, to);
+}
 void Section::setValueForAll(CharacterSheetItem* itemSrc, int col)
 {
     for(auto& key : m_keyList)
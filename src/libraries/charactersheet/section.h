@@ -159,6 +159,15 @@ public:
     void setOrig(CharacterSheetItem* orig) override;
     void changeKeyChild(QString oldkey, QString newKey, CharacterSheetItem* child) override;
     void getFieldFromPage(int pagePos, QList<CharacterSheetItem*>& list);
+    /**
+     * @brief takeChildAt removes the child at pos from the section without deleting it.
+     */
+    CharacterSheetItem* takeChildAt(int pos);
+    void moveChild(int from, int to);
+    /**
+     * @brief buildItemInto adds to the character the field or the table described by the structure item.
+     */
+    static void buildItemInto(CharacterSheet* character, CharacterSheetItem* item);
 public slots:
     /**
      * @brief fillList
@@ -0,0 +1,207 @@
+#include "sectiondiff.h"
+
+#include <QHash>
+#include <algorithm>
+
+#include "section.h"
+#include "tablefield.h"
+
+namespace
+{
+void collectFields(const CharacterSheetItem* parent, QList<CharacterSheetItem*>& fields)
+{
+    for(int i= 0; i < parent->getChildrenCount(); ++i)
+    {
+        auto child= parent->getChildAt(i);
+        if(nullptr == child)
+            continue;
+
+        if(CharacterSheetItem::SectionItem == child->getItemType())
+            collectFields(child, fields);
+        else
+            fields.append(child);
+    }
+}
+} // namespace
+
+SectionDiff SectionDiff::compute(const Section* from, const Section* to)
+{
+    SectionDiff diff;
+    QList<CharacterSheetItem*> oldFields;
+    QList<CharacterSheetItem*> newFields;
+    if(nullptr != from)
+        collectFields(from, oldFields);
+    if(nullptr != to)
+        collectFields(to, newFields);
+
+    QHash<QString, CharacterSheetItem*> oldById;
+    oldById.reserve(oldFields.size());
+    for(auto field : oldFields)
+        oldById.insert(field->getId(), field);
+
+    QHash<QString, CharacterSheetItem*> newById;
+    newById.reserve(newFields.size());
+    for(auto field : newFields)
+    {
+        newById.insert(field->getId(), field);
+        auto old= oldById.value(field->getId());
+        // a field which became a table (or the opposite) is built again.
+        if(nullptr == old || old->getItemType() != field->getItemType())
+        {
+            diff.added.append(field);
+            continue;
+        }
+        if(old->getFieldType() != field->getFieldType())
+            diff.retyped.append(field);
+        if(old->getLabel() != field->getLabel())
+            diff.relabelled.append(field);
+    }
+
+    for(auto field : oldFields)
+    {
+        auto current= newById.value(field->getId());
+        if(nullptr == current || current->getItemType() != field->getItemType())
+            diff.removed.append(field->getId());
+    }
+    return diff;
+}
+
+bool SectionDiff::sameShape(const CharacterSheetItem* first, const CharacterSheetItem* second)
+{
+    if(nullptr == first || nullptr == second)
+        return first == second;
+
+    if(first->getItemType() != second->getItemType() || first->getId() != second->getId()
+       || first->getChildrenCount() != second->getChildrenCount())
+        return false;
+
+    for(int i= 0; i < first->getChildrenCount(); ++i)
+    {
+        if(!sameShape(first->getChildAt(i), second->getChildAt(i)))
+            return false;
+    }
+    return true;
+}
+
+bool SectionDiff::isEmpty() const
+{
+    return added.isEmpty() && removed.isEmpty() && retyped.isEmpty() && relabelled.isEmpty();
+}
+
+void SectionDiff::applyTo(CharacterSheet* character) const
+{
+    if(nullptr == character)
+        return;
+
+    for(auto const& id : removed)
+        character->removeField(id);
+
+    for(auto item : added)
+        Section::buildItemInto(character, item);
+
+    for(auto item : retyped)
+        character->updateFieldSchema(item);
+
+    for(auto item : relabelled)
+        character->updateFieldSchema(item);
+}
+
+FieldSchema FieldSchema::fromItem(const CharacterSheetItem* item)
+{
+    FieldSchema schema;
+    if(nullptr == item)
+        return schema;
+
+    schema.id= item->getId();
+    schema.label= item->getLabel();
+    schema.type= item->getFieldType();
+    schema.childIds.reserve(item->getChildrenCount());
+    for(int i= 0; i < item->getChildrenCount(); ++i)
+    {
+        auto child= item->getChildAt(i);
+        schema.childIds.append(nullptr != child ? child->getId() : QString());
+    }
+    return schema;
+}
+
+CharacterPatch CharacterPatch::plan(CharacterSheet* sheet, const QList<FieldSchema>& structure)
+{
+    CharacterPatch patch;
+    patch.sheet= sheet;
+    for(int i= 0; i < structure.size(); ++i)
+    {
+        auto const& schema= structure.at(i);
+        if(!sheet->hasField(schema.id))
+        {
+            patch.missing.append(i);
+            continue;
+        }
+
+        auto const value= sheet->fieldValue(schema.id);
+        if(value.typeField != schema.type)
+            patch.retyped.append(i);
+        if(value.label != schema.label)
+            patch.relabelled.append(i);
+
+        if(schema.childIds.isEmpty())
+            continue;
+        // plans are made on worker threads, getChildAt would build compact lines.
+        auto table= dynamic_cast<TableField*>(sheet->existingItem(schema.id));
+        if(nullptr == table)
+            continue;
+        auto const childIds= table->childIds();
+        auto const count= std::min(childIds.size(), schema.childIds.size());
+        for(int j= 0; j < count; ++j)
+        {
+            if(!schema.childIds.at(j).isEmpty() && childIds.at(j) != schema.childIds.at(j))
+                patch.wrongChildIds.append(qMakePair(i, j));
+        }
+    }
+    return patch;
+}
+
+bool CharacterPatch::isEmpty() const
+{
+    return missing.isEmpty() && retyped.isEmpty() && relabelled.isEmpty() && wrongChildIds.isEmpty();
+}
+
+void CharacterPatch::apply(const QList<FieldSchema>& structure, Section* section) const
+{
+    if(nullptr == sheet || nullptr == section || isEmpty())
+        return;
+
+    for(auto i : missing)
+    {
+        auto item= section->getChildAt(i);
+        if(nullptr == item)
+            continue;
+
+        if(item->getFieldType() == CharacterSheetItem::TABLE)
+        {
+            TableField* newtablefield= new TableField(false);
+            newtablefield->copyField(item, true);
+            sheet->insertCharacterItem(newtablefield);
+        }
+        else
+        {
+            // the default value of the structure is kept, the item is created on demand.
+            auto value= FieldValue::fromItem(item);
+            value.readOnly= false;
+            sheet->insertFieldValue(value);
+        }
+    }
+
+    for(auto const& pair : wrongChildIds)
+    {
+        auto item= sheet->existingItem(structure.at(pair.first).id);
+        auto child= nullptr != item ? item->getChildAt(pair.second) : nullptr;
+        if(nullptr != child)
+            child->setId(structure.at(pair.first).childIds.at(pair.second));
+    }
+
+    for(auto i : retyped)
+        sheet->updateFieldSchema(section->getChildAt(i));
+
+    for(auto i : relabelled)
+        sheet->updateFieldSchema(section->getChildAt(i));
+}
@@ -0,0 +1,73 @@
+#ifndef SECTIONDIFF_H
+#define SECTIONDIFF_H
+
+#include <QList>
+#include <QPair>
+#include <QStringList>
+
+#include <charactersheet/charactersheetitem.h>
+
+class CharacterSheet;
+class Section;
+
+/**
+ * @brief The SectionDiff struct lists the fields which differ between two versions of the sheet structure.
+ * Fields are matched by id, the fields of nested sections are compared too as characters store them flat.
+ * Items of the lists belong to the new structure.
+ */
+struct SectionDiff
+{
+    QList<CharacterSheetItem*> added;
+    QStringList removed;
+    QList<CharacterSheetItem*> retyped;
+    QList<CharacterSheetItem*> relabelled;
+
+    static SectionDiff compute(const Section* from, const Section* to);
+    /**
+     * @brief sameShape tells if both items have the same kind and the same children, at any depth.
+     * Items with the same shape can replace each other in the model without moving any row.
+     */
+    static bool sameShape(const CharacterSheetItem* first, const CharacterSheetItem* second);
+
+    bool isEmpty() const;
+    /**
+     * @brief applyTo updates the fields of the character in one pass, values of kept fields are untouched.
+     */
+    void applyTo(CharacterSheet* character) const;
+};
+
+/**
+ * @brief The FieldSchema struct is a plain copy of what characters must match for one structure item.
+ */
+struct FieldSchema
+{
+    QString id;
+    QString label;
+    CharacterSheetItem::TypeField type= CharacterSheetItem::TEXTINPUT;
+    QStringList childIds;
+
+    static FieldSchema fromItem(const CharacterSheetItem* item);
+};
+
+/**
+ * @brief The CharacterPatch struct lists the changes a character needs to match the structure.
+ * plan only reads the character so characters can be planned on worker threads while the owner thread waits,
+ * apply changes the QObjects and must be called on the owner thread.
+ */
+struct CharacterPatch
+{
+    CharacterSheet* sheet= nullptr;
+    QList<int> missing;
+    QList<int> retyped;
+    QList<int> relabelled;
+    QList<QPair<int, int>> wrongChildIds; // structure item, child
+
+    static CharacterPatch plan(CharacterSheet* sheet, const QList<FieldSchema>& structure);
+    bool isEmpty() const;
+    /**
+     * @brief apply uses the children of the section the structure has been built from.
+     */
+    void apply(const QList<FieldSchema>& structure, Section* section) const;
+};
+
+#endif // SECTIONDIFF_H
@@ -21,12 +21,17 @@
  ***************************************************************************/
 #include "tablefield.h"
 #include "field.h"
+#include <QCoreApplication>
 #include <QDebug>
 #include <QJsonArray>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QRegularExpression>
+#include <QScopedValueRollback>
 #include <QUuid>
 
+#include <charactersheet/formula/formulamanager.h>
+
 #ifdef RCSE
 #include "controllers/editorcontroller.h"
 #endif
@@ -35,12 +40,26 @@
 TableCanvasField::TableCanvasField() {}
 #endif
 
+namespace
+{
+// lines given to the view each time it needs more of them.
+constexpr int fetchBatchSize= 50;
+// lines kept built, the least recently used ones go back to plain values past it.
+constexpr int maxBuiltLines= 4 * fetchBatchSize;
+// results kept for each computed column, the cache is dropped when full.
+constexpr int maxCachedResults= 1024;
+
+void drainLinePool()
+{
+    LineFieldItem::pool().setCapacity(0);
+}
+} // namespace
+
 void copyModel(LineModel* src, LineModel* dest, CharacterSheetItem* parent)
 {
-    QJsonArray array;
-    src->saveDataItem(array);
-    dest->loadDataItem(array, parent);
+    dest->copyDataItem(src, parent);
 }
+
 //////////////////////////////////////////
 /// @brief LineFieldItem::createLineItem
 /// @return
@@ -50,6 +69,41 @@ LineFieldItem::LineFieldItem(QObject* parent) : QObject(parent) {}
 
 LineFieldItem::~LineFieldItem() {}
 
+ObjectPool<LineFieldItem>& LineFieldItem::pool()
+{
+    static ObjectPool<LineFieldItem> pool([]() { return new LineFieldItem(); });
+    // same as FieldController::pool, lines go with the application.
+    static const bool drained= []()
+    {
+        qAddPostRoutine(drainLinePool);
+        return true;
+    }();
+    Q_UNUSED(drained)
+    return pool;
+}
+
+void LineFieldItem::dispose()
+{
+    for(auto field : m_fields)
+    {
+        disconnect(field, nullptr, field->getParent(), nullptr);
+        field->deleteLater();
+    }
+    m_fields.clear();
+    disconnect();
+    deleteLater();
+}
+
+int LineFieldItem::row() const
+{
+    return m_row;
+}
+
+void LineFieldItem::setRow(int row)
+{
+    m_row= row;
+}
+
 void LineFieldItem::insertField(FieldController* field)
 {
     m_fields.append(field);
@@ -127,18 +181,50 @@ void LineFieldItem::load(QJsonArray& json, EditorController* ctrl, CharacterShee
         m_fields.append(field);
     }
 }
+FieldController* LineFieldItem::createField(CharacterSheetItem* parent)
+{
+    auto field= FieldController::pool().acquire();
+    field->setParent(parent);
+    connect(field, &FieldController::characterSheetItemChanged, parent,
+            &CharacterSheetItem::characterSheetItemChanged);
+    connect(field, &FieldController::updateNeeded, parent, &CharacterSheetItem::updateNeeded);
+    m_fields.append(field);
+    return field;
+}
+
 void LineFieldItem::loadDataItem(QJsonArray& json, CharacterSheetItem* parent)
 {
+    m_fields.reserve(m_fields.size() + json.size());
     for(auto const value : json)
     {
-        auto field= new FieldController();
-        field->setParent(parent);
-        connect(field, &FieldController::characterSheetItemChanged, parent,
-                &CharacterSheetItem::characterSheetItemChanged);
-        connect(field, &FieldController::updateNeeded, parent, &CharacterSheetItem::updateNeeded);
+        auto field= createField(parent);
         QJsonObject obj= value.toObject();
         field->loadDataItem(obj);
-        m_fields.append(field);
+    }
+}
+
+void LineFieldItem::loadDataItem(const QList<FieldValue>& values, CharacterSheetItem* parent)
+{
+    m_fields.reserve(m_fields.size() + values.size());
+    for(auto const& value : values)
+    {
+        auto field= createField(parent);
+        // building a line is not an edition.
+        QSignalBlocker blocker(field);
+        value.applyTo(field);
+    }
+}
+
+void LineFieldItem::copyDataItem(const LineFieldItem* src, CharacterSheetItem* parent)
+{
+    if(nullptr == src)
+        return;
+
+    m_fields.reserve(m_fields.size() + src->m_fields.size());
+    for(auto const srcField : src->m_fields)
+    {
+        auto field= createField(parent);
+        field->copyDataItem(srcField);
     }
 }
 
@@ -146,19 +232,36 @@ void LineFieldItem::loadDataItem(QJsonArray& json, CharacterSheetItem* parent)
 //
 ////////////////////////////////////////
 LineModel::LineModel() {}
+
+LineModel::~LineModel()
+{
+    delete m_formulaManager;
+}
 int LineModel::rowCount(const QModelIndex& parent) const
 {
     if(!parent.isValid())
-        return m_lines.size();
+        return m_fetchedCount;
     return 0;
 }
 
+bool LineModel::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && m_fetchedCount < m_rows.size();
+}
+
+void LineModel::fetchMore(const QModelIndex& parent)
+{
+    if(parent.isValid())
+        return;
+    fetchLines(fetchBatchSize);
+}
+
 QVariant LineModel::data(const QModelIndex& index, int role) const
 {
     if(!index.isValid())
         return QVariant();
 
-    auto item= m_lines.at(index.row());
+    auto item= lineAt(index.row());
 
     if(role == LineRole)
     {
@@ -172,17 +275,39 @@ QVariant LineModel::data(const QModelIndex& index, int role) const
     // return QVariant();
 }
 
+void LineModel::multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const
+{
+    if(!index.isValid())
+    {
+        for(auto& roleData : roleDataSpan)
+            roleData.clearData();
+        return;
+    }
+
+    auto item= lineAt(index.row());
+    for(auto& roleData : roleDataSpan)
+    {
+        auto const role= roleData.role();
+        if(role == LineRole)
+            roleData.setData(QVariant::fromValue<LineFieldItem*>(item));
+        else
+            roleData.setData(QVariant::fromValue<FieldController*>(item->getField((role - (LineRole + 1)) / 2)));
+    }
+}
+
 QHash<int, QByteArray> LineModel::roleNames() const
 {
     QHash<int, QByteArray> roles;
     roles[LineRole]= "line";
+    if(m_rows.isEmpty())
+        return roles;
+
     int i= 1;
-    auto first= m_lines.first();
-    for(auto& fieldLine : first->getFields())
+    for(auto const& cell : lineValues(0))
     {
-        roles[LineRole + i]= fieldLine->getId().toUtf8();
+        roles[LineRole + i]= cell.id.toUtf8();
         i++;
-        roles[LineRole + i]= fieldLine->getLabel().toUtf8();
+        roles[LineRole + i]= cell.label.toUtf8();
         i++;
     }
     return roles;
@@ -190,87 +315,200 @@ QHash<int, QByteArray> LineModel::roleNames() const
 
 void LineModel::insertLine(LineFieldItem* line)
 {
-    beginInsertRows(QModelIndex(), m_lines.size(), m_lines.size());
-    m_lines.append(line);
+    fetchUpTo(lineCount());
+    beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size());
+    m_rows.append(Row{line});
+    ++m_builtCount;
+    ++m_fetchedCount;
+    trackLine(line, m_rows.size() - 1);
     endInsertRows();
+    emit lineCountChanged();
 }
 
 void LineModel::appendLine(TableField* field)
 {
-    if(m_lines.isEmpty())
+    insertLines(lineCount(), 1, field);
+}
+
+void LineModel::insertLines(int pos, int count, TableField* field)
+{
+    if(m_rows.isEmpty() || count <= 0)
         return;
 
-    auto line= m_lines.last();
-    QJsonArray array;
-    line->save(array);
-    auto fieldLine= new LineFieldItem();
-    fieldLine->loadDataItem(array, field);
-    insertLine(fieldLine);
+    if(nullptr == m_parent)
+        m_parent= field;
+    pos= qBound(0, pos, lineCount());
+
+    // new lines copy the last one, they are built when the view asks for them.
+    auto const values= lineValues(m_rows.size() - 1);
+    auto const notify= pos <= m_fetchedCount;
+    if(notify)
+        beginInsertRows(QModelIndex(), pos, pos + count - 1);
+    m_rows.reserve(m_rows.size() + count);
+    for(int i= 0; i < count; ++i)
+        insertCompactLine(pos + i, values);
+    updateRows(pos + count);
+    if(notify)
+    {
+        m_fetchedCount+= count;
+        endInsertRows();
+    }
+    emit lineCountChanged();
 }
 
 void LineModel::clear()
 {
     beginResetModel();
-    qDeleteAll(m_lines);
-    m_lines.clear();
+    releaseLines();
     endResetModel();
 }
 
+void LineModel::releaseLines()
+{
+    resetAggregates();
+    for(auto const& row : std::as_const(m_rows))
+    {
+        if(nullptr != row.line)
+            row.line->dispose();
+    }
+    m_rows.clear();
+    m_fetchedCount= 0;
+    m_builtCount= 0;
+}
+
 int LineModel::getChildrenCount() const
 {
-    if(!m_lines.isEmpty())
+    if(!m_rows.isEmpty())
     {
-        return m_lines.size() * getColumnCount();
+        return lineCount() * getColumnCount();
     }
     return 0;
 }
 
+int LineModel::lineCount() const
+{
+    return m_rows.size();
+}
+
 FieldController* LineModel::getFieldById(const QString& id)
 {
-    for(auto& line : m_lines)
+    if(m_cellIndexDirty)
+        rebuildCellIndex();
+
+    auto it= m_cellById.constFind(id);
+    if(it == m_cellById.constEnd())
+        return nullptr;
+
+    auto const cell= it.value();
+    return buildLine(cell.row)->getField(cell.column);
+}
+
+FieldController* LineModel::getFieldById(int line, const QString& id)
+{
+    if(m_cellIndexDirty)
+        rebuildCellIndex();
+
+    auto it= m_columnByCell.constFind(qMakePair(line, id));
+    if(it == m_columnByCell.constEnd())
+        return nullptr;
+
+    return buildLine(line)->getField(it.value());
+}
+
+int LineModel::lineOfField(const FieldController* field)
+{
+    auto const index= indexOfField(field);
+    return index < 0 ? -1 : index / getColumnCount();
+}
+
+int LineModel::indexOfField(const FieldController* field)
+{
+    if(nullptr == field || m_rows.isEmpty())
+        return -1;
+
+    // ids are duplicated between lines, only built lines may hold the field.
+    auto const columnCount= getColumnCount();
+    for(int row= 0; row < m_rows.size(); ++row)
     {
-        auto item= line->getFieldById(id);
-        if(nullptr != item)
-            return item;
+        auto line= m_rows.at(row).line;
+        if(nullptr == line)
+            continue;
+        auto column= line->getFields().indexOf(const_cast<FieldController*>(field));
+        if(column >= 0)
+            return row * columnCount + column;
     }
-    return nullptr;
+    return -1;
+}
+
+QStringList LineModel::cellIds() const
+{
+    QStringList ids;
+    auto const columnCount= getColumnCount();
+    ids.reserve(lineCount() * columnCount);
+    for(auto const& row : m_rows)
+    {
+        for(int column= 0; column < columnCount; ++column)
+        {
+            if(nullptr != row.line)
+            {
+                auto field= row.line->getField(column);
+                ids << (nullptr == field ? QString() : field->getId());
+            }
+            else
+            {
+                ids << (column < row.values.size() ? row.values.at(column).id : QString());
+            }
+        }
+    }
+    return ids;
 }
 
 int LineModel::getColumnCount() const
 {
-    if(!m_lines.isEmpty())
+    if(!m_rows.isEmpty())
     {
-        auto line= m_lines.first();
-        return line->getFieldCount();
+        auto const& first= m_rows.first();
+        return nullptr != first.line ? first.line->getFieldCount() : first.values.size();
     }
     return -1;
 }
 
 FieldController* LineModel::getField(int line, int col)
 {
-    if(m_lines.size() > line)
-    {
-        return m_lines.at(line)->getField(col);
-    }
+    if(line >= 0 && lineCount() > line)
+        return buildLine(line)->getField(col);
     return nullptr;
 }
 
 void LineModel::save(QJsonArray& json)
 {
-    for(auto& line : m_lines)
+    fetchUpTo(lineCount());
+    for(int row= 0; row < m_rows.size(); ++row)
     {
         QJsonArray lineJson;
-        line->save(lineJson);
+        buildLine(row)->save(lineJson);
         json.append(lineJson);
     }
 }
 
 void LineModel::saveDataItem(QJsonArray& json)
 {
-    for(auto& line : m_lines)
+    for(auto const& row : m_rows)
     {
         QJsonArray lineJson;
-        line->saveDataItem(lineJson);
+        if(nullptr != row.line)
+        {
+            row.line->saveDataItem(lineJson);
+        }
+        else
+        {
+            for(auto const& value : row.values)
+            {
+                QJsonObject obj;
+                value.toJson(obj);
+                lineJson.append(obj);
+            }
+        }
         json.append(lineJson);
     }
 }
@@ -284,71 +522,169 @@ void LineModel::load(const QJsonArray& json, EditorController* ctrl, CharacterSh
         QJsonArray obj= array.toArray();
         LineFieldItem* line= new LineFieldItem();
         line->load(obj, ctrl, parent);
-        m_lines.append(line);
+        m_rows.append(Row{line});
+        ++m_builtCount;
+        trackLine(line, m_rows.size() - 1);
     }
+    m_fetchedCount= m_rows.size();
     endResetModel();
 }
 
-void LineModel::loadDataItem(const QJsonArray& json, CharacterSheetItem* parent)
+void LineModel::loadLines(const QList<QList<FieldValue>>& lines, CharacterSheetItem* parent)
 {
     beginResetModel();
-    m_lines.clear();
-    for(auto const& array : json)
-    {
-        QJsonArray obj= array.toArray();
-        LineFieldItem* line= new LineFieldItem();
-        line->loadDataItem(obj, parent);
-        m_lines.append(line);
-    }
+    releaseLines();
+    m_parent= parent;
+
+    // lines are kept as plain values, items are built when the view asks for them.
+    m_rows.reserve(lines.size());
+    m_columns.reserve(lines.size(), lines.isEmpty() ? 0 : lines.first().size());
+    for(auto const& values : lines)
+        insertCompactLine(lineCount(), values);
+    m_fetchedCount= std::min(fetchBatchSize, lineCount());
+    endResetModel();
+}
+
+void LineModel::copyDataItem(const LineModel* src, CharacterSheetItem* parent)
+{
+    if(nullptr == src || src == this)
+        return;
+
+    beginResetModel();
+    releaseLines();
+    m_parent= parent;
+
+    m_rows.reserve(src->lineCount());
+    m_columns.reserve(src->lineCount(), src->getColumnCount());
+    for(int row= 0; row < src->lineCount(); ++row)
+        insertCompactLine(row, src->lineValues(row));
+    m_fetchedCount= std::min(fetchBatchSize, lineCount());
+    m_columnFormulas= src->m_columnFormulas;
+    for(auto& formula : m_columnFormulas)
+        formula.compiled= false;
     endResetModel();
 }
 
 void LineModel::setChildFieldData(const QJsonObject& json)
 {
-    for(auto& line : m_lines)
+    if(m_cellIndexDirty)
+        rebuildCellIndex();
+
+    auto const id= json["id"].toString();
+    CellIndex cell;
+    if(json.contains("line"))
     {
-        auto field= line->getFieldById(json["id"].toString());
-        if(field)
-        {
-            field->loadDataItem(json);
+        auto it= m_columnByCell.constFind(qMakePair(json["line"].toInt(), id));
+        if(it == m_columnByCell.constEnd())
             return;
-        }
+        cell= {it.key().first, it.value()};
+    }
+    else
+    {
+        auto it= m_cellById.constFind(id);
+        if(it == m_cellById.constEnd())
+            return;
+        cell= it.value();
     }
+
+    auto& row= m_rows[cell.row];
+    if(nullptr != row.line)
+    {
+        row.line->getField(cell.column)->loadDataItem(json);
+        return;
+    }
+
+    // compact line: no item to update, the value is changed in place.
+    auto& value= row.values[cell.column];
+    value= FieldValue::fromJson(json);
+    m_columns.setCell(cell.row, cell.column, value.value);
+    updateComputedCells(cell.row, cell.column);
+    emit contentChanged();
 }
 
 void LineModel::setFieldInDictionnary(QHash<QString, QString>& dict, const QString& id, const QString& label) const
 {
-    if(m_lines.isEmpty())
+    if(m_rows.isEmpty())
         return;
 
-    auto line= m_lines.at(0);
-    auto fields= line->getFields();
-    int i= 1; // count as user
-    for(auto field : fields)
+    auto const count= getColumnCount();
+    for(int column= 0; column < count; ++column)
     {
-        auto sum= sumColumn(field->getLabel());
-        QString key= QStringLiteral("%1:sumcol%2").arg(id).arg(i);
-        dict[key]= QString::number(sum);
-        if(!label.isEmpty())
+        auto const& agg= aggregate(column);
+        auto const hasNumber= agg.count > 0;
+        const std::pair<QString, QString> values[]
+            = {{QStringLiteral("sumcol"), QString::number(agg.sum)},
+               {QStringLiteral("mincol"), QString::number(hasNumber ? agg.min : 0)},
+               {QStringLiteral("maxcol"), QString::number(hasNumber ? agg.max : 0)},
+               {QStringLiteral("avgcol"), QString::number(agg.average())},
+               {QStringLiteral("countcol"), QString::number(agg.count)}};
+
+        auto const number= column + 1; // count as user
+        for(auto const& value : values)
         {
-            key= QStringLiteral("%1:sumcol%2").arg(label).arg(i);
-            dict[key]= QString::number(sum);
+            dict[QStringLiteral("%1:%2%3").arg(id, value.first).arg(number)]= value.second;
+            if(!label.isEmpty())
+                dict[QStringLiteral("%1:%2%3").arg(label, value.first).arg(number)]= value.second;
         }
-        ++i;
     }
 }
 
 void LineModel::removeLine(int index)
 {
-    if(m_lines.isEmpty())
-        return;
-    if(m_lines.size() <= index)
+    removeLines(index, index);
+}
+
+void LineModel::removeLines(int first, int last)
+{
+    auto const total= lineCount();
+    if(total == 0)
         return;
-    if(index < 0)
+
+    first= std::max(first, 0);
+    last= std::min(last, total - 1);
+    if(first > last)
         return;
-    beginRemoveRows(QModelIndex(), index, index);
-    m_lines.removeAt(index);
-    endRemoveRows();
+
+    auto const lastFetched= std::min(last, m_fetchedCount - 1);
+    auto const notify= first <= lastFetched;
+
+    if(notify)
+        beginRemoveRows(QModelIndex(), first, lastFetched);
+
+    QList<LineFieldItem*> removed;
+    for(int row= first; row <= last; ++row)
+    {
+        auto line= m_rows.at(row).line;
+        if(nullptr == line)
+            continue;
+        untrackLine(line);
+        removed << line;
+    }
+    m_builtCount-= removed.size();
+    m_rows.erase(m_rows.begin() + first, m_rows.begin() + last + 1);
+    if(notify)
+        m_fetchedCount-= lastFetched - first + 1;
+
+    if(lineCount() == 0)
+    {
+        resetAggregates();
+    }
+    else
+    {
+        m_columns.removeRows(first, last);
+        m_cellIndexDirty= true;
+        updateRows(first);
+    }
+    if(notify)
+        endRemoveRows();
+
+    for(auto line : removed)
+        line->dispose();
+
+    // views stop asking for lines once they have none.
+    if(m_fetchedCount == 0)
+        fetchLines(fetchBatchSize);
+    emit lineCountChanged();
 }
 
 bool LineModel::setData(const QModelIndex& index, const QVariant& data, int role)
@@ -358,21 +694,497 @@ bool LineModel::setData(const QModelIndex& index, const QVariant& data, int role
 
 int LineModel::sumColumn(const QString& name) const
 {
-    int sum= 0;
-    for(auto line : m_lines)
+    return static_cast<int>(columnAggregate(name).sum);
+}
+
+LineModel::ColumnAggregate LineModel::columnAggregate(const QString& name) const
+{
+    auto column= columnIndex(name);
+    if(column < 0)
+        return {};
+    return aggregate(column);
+}
+
+int LineModel::columnIndex(const QString& name) const
+{
+    if(m_rows.isEmpty())
+        return -1;
+
+    auto it= m_columnByName.constFind(name);
+    if(it != m_columnByName.constEnd())
+        return it.value();
+
+    auto const cells= lineValues(0);
+    auto found= std::find_if(cells.begin(), cells.end(), [name](const FieldValue& cell) { return cell.label == name; });
+    if(found == cells.end())
     {
-        auto field= line->getFieldByLabel(name);
-        if(nullptr == field)
+        // should not happen
+        found= std::find_if(cells.begin(), cells.end(), [name](const FieldValue& cell) { return cell.id == name; });
+    }
+    if(found == cells.end())
+        return -1;
+
+    auto column= static_cast<int>(std::distance(cells.begin(), found));
+    m_columnByName.insert(name, column);
+    return column;
+}
+
+void LineModel::trackLine(LineFieldItem* line, int row, bool newRow)
+{
+    if(nullptr == line)
+        return;
+
+    line->setRow(row);
+    // a line inserted before others moves their cells.
+    if(newRow && row != lineCount() - 1)
+        m_cellIndexDirty= true;
+
+    auto const& fields= line->getFields();
+    QStringList values;
+    values.reserve(fields.size());
+    int column= 0;
+    for(auto field : fields)
+    {
+        values << field->value();
+        if(newRow && !m_cellIndexDirty)
+            indexCell(row, column, field->getId());
+        connect(field, &FieldController::valueChanged, this, [this, line, field, column]() {
+            if(m_bulkUpdate)
+                return;
+            auto row= line->row();
+            m_columns.setCell(row, column, field->value());
+            updateComputedCells(row, column);
+        });
+        connect(field, &FieldController::idChanged, this, [this]() { m_cellIndexDirty= true; });
+        // values from network and formula only edits do not go through characterSheetItemChanged.
+        connect(field, &FieldController::dataItemChanged, this, [this]() {
+            if(!m_bulkUpdate)
+                emit contentChanged();
+        });
+        ++column;
+    }
+    if(newRow)
+        m_columns.insertRow(row, values);
+}
+
+void LineModel::untrackLine(LineFieldItem* line)
+{
+    if(nullptr == line)
+        return;
+
+    for(auto field : line->getFields())
+        disconnect(field, nullptr, this, nullptr);
+    m_columnByName.clear();
+}
+
+QList<QList<FieldValue>> LineModel::lines() const
+{
+    QList<QList<FieldValue>> lines;
+    lines.reserve(m_rows.size());
+    for(int row= 0; row < lineCount(); ++row)
+        lines.append(lineValues(row));
+    return lines;
+}
+
+QList<FieldValue> LineModel::lineValues(int row) const
+{
+    auto const& current= m_rows.at(row);
+    if(nullptr == current.line)
+        return current.values;
+
+    QList<FieldValue> values;
+    auto const fields= current.line->getFields();
+    values.reserve(fields.size());
+    for(auto field : fields)
+        values << FieldValue::fromItem(field);
+    return values;
+}
+
+void LineModel::insertCompactLine(int row, const QList<FieldValue>& values)
+{
+    QStringList cells;
+    cells.reserve(values.size());
+    for(auto const& value : values)
+        cells << value.value;
+
+    m_rows.insert(row, Row{nullptr, values});
+    m_columns.insertRow(row, cells);
+    m_cellIndexDirty= true;
+}
+
+void LineModel::updateRows(int first)
+{
+    // built lines know their row, cell edits find it without searching.
+    for(int row= first; row < m_rows.size(); ++row)
+    {
+        if(nullptr != m_rows.at(row).line)
+            m_rows.at(row).line->setRow(row);
+    }
+}
+
+LineFieldItem* LineModel::lineAt(int row) const
+{
+    // lines are built on demand, from the const accessors of the view as well.
+    return const_cast<LineModel*>(this)->buildLine(row);
+}
+
+LineFieldItem* LineModel::buildLine(int row)
+{
+    auto& current= m_rows[row];
+    current.lastUse= ++m_useClock;
+    if(nullptr != current.line)
+        return current.line;
+
+    auto line= LineFieldItem::pool().acquire();
+    line->loadDataItem(current.values, m_parent);
+    current.line= line;
+    current.values.clear();
+    trackLine(line, row, false);
+    ++m_builtCount;
+
+    if(m_builtCount > maxBuiltLines && !m_compactionScheduled && nullptr != m_parent)
+    {
+        m_compactionScheduled= true;
+        QMetaObject::invokeMethod(this, &LineModel::compactLines, Qt::QueuedConnection);
+    }
+    return line;
+}
+
+void LineModel::compactLines()
+{
+    m_compactionScheduled= false;
+    if(m_builtCount <= maxBuiltLines)
+        return;
+
+    QList<int> built;
+    built.reserve(m_builtCount);
+    for(int row= 0; row < m_rows.size(); ++row)
+    {
+        if(nullptr != m_rows.at(row).line)
+            built << row;
+    }
+    std::sort(built.begin(), built.end(),
+              [this](int a, int b) { return m_rows.at(a).lastUse < m_rows.at(b).lastUse; });
+
+    // the least recently used lines go back to plain values, half of the budget is kept.
+    built.resize(m_builtCount - maxBuiltLines / 2);
+    std::sort(built.begin(), built.end());
+    for(auto row : std::as_const(built))
+    {
+        auto& current= m_rows[row];
+        current.values= lineValues(row);
+        untrackLine(current.line);
+        current.line->dispose();
+        current.line= nullptr;
+    }
+    m_builtCount-= built.size();
+    emit linesCompacted();
+
+    // views still showing a compacted line get the new one.
+    QList<int> roles= roleNames().keys();
+    for(int i= 0; i < built.size();)
+    {
+        auto const first= built.at(i);
+        auto last= first;
+        while(++i < built.size() && built.at(i) == last + 1)
+            ++last;
+        if(first < m_fetchedCount)
+            emit dataChanged(index(first), index(std::min(last, m_fetchedCount - 1)), roles);
+    }
+}
+
+void LineModel::fetchLines(int count)
+{
+    count= std::min(count, static_cast<int>(m_rows.size()) - m_fetchedCount);
+    if(count <= 0)
+        return;
+
+    beginInsertRows(QModelIndex(), m_fetchedCount, m_fetchedCount + count - 1);
+    m_fetchedCount+= count;
+    endInsertRows();
+}
+
+void LineModel::fetchUpTo(int lineCount)
+{
+    if(lineCount > m_fetchedCount)
+        fetchLines(lineCount - m_fetchedCount);
+}
+
+void LineModel::resetAggregates()
+{
+    m_columns.clear();
+    m_columnByName.clear();
+    for(auto& formula : m_columnFormulas)
+        formula.compiled= false;
+    m_cellById.clear();
+    m_columnByCell.clear();
+    m_cellIndexDirty= false;
+}
+
+void LineModel::rebuildCellIndex()
+{
+    m_cellById.clear();
+    m_columnByCell.clear();
+    for(int row= 0; row < m_rows.size(); ++row)
+    {
+        auto const& current= m_rows.at(row);
+        int column= 0;
+        if(nullptr != current.line)
+        {
+            for(auto field : current.line->getFields())
+                indexCell(row, column++, field->getId());
+        }
+        else
         {
-            // should not happen
-            field= line->getFieldById(name);
+            for(auto const& value : current.values)
+                indexCell(row, column++, value.id);
         }
-        if(nullptr == field)
+    }
+    m_cellIndexDirty= false;
+}
+
+void LineModel::indexCell(int row, int column, const QString& id)
+{
+    if(!m_cellById.contains(id))
+        m_cellById.insert(id, {row, column});
+    m_columnByCell.insert(qMakePair(row, id), column);
+}
+
+const LineModel::ColumnAggregate& LineModel::aggregate(int column) const
+{
+    return m_columns.aggregate(column);
+}
+
+void LineModel::setColumnFormula(int column, const QString& formula)
+{
+    if(column < 0)
+        return;
+
+    if(formula.isEmpty())
+    {
+        // formulas are saved with the lines.
+        if(m_columnFormulas.remove(column) > 0)
+            emit contentChanged();
+        return;
+    }
+
+    m_columnFormulas.insert(column, makeColumnFormula(formula));
+    computeColumn(column);
+}
+
+LineModel::ColumnFormula LineModel::makeColumnFormula(const QString& formula)
+{
+    static const QRegularExpression reference(QStringLiteral("\\$\\{([^}]+)\\}"));
+    ColumnFormula columnFormula;
+    columnFormula.formula= formula;
+    auto it= reference.globalMatch(formula);
+    while(it.hasNext())
+    {
+        auto name= it.next().captured(1);
+        if(!columnFormula.names.contains(name))
+            columnFormula.names << name;
+    }
+    return columnFormula;
+}
+
+QString LineModel::columnFormula(int column) const
+{
+    return m_columnFormulas.value(column).formula;
+}
+
+void LineModel::saveColumnFormulas(QJsonArray& json) const
+{
+    for(auto it= m_columnFormulas.constBegin(); it != m_columnFormulas.constEnd(); ++it)
+    {
+        QJsonObject obj;
+        obj["column"]= it.key();
+        obj["formula"]= it.value().formula;
+        json.append(obj);
+    }
+}
+
+void LineModel::loadColumnFormulas(const QJsonArray& json)
+{
+    QList<QPair<int, QString>> formulas;
+    for(auto const& value : json)
+    {
+        auto obj= value.toObject();
+        formulas.append({obj["column"].toInt(), obj["formula"].toString()});
+    }
+    loadColumnFormulas(formulas);
+}
+
+void LineModel::loadColumnFormulas(const QList<QPair<int, QString>>& formulas)
+{
+    // saved cells already hold the results, they are computed again when an input changes.
+    m_columnFormulas.clear();
+    for(auto const& formula : formulas)
+    {
+        if(!formula.second.isEmpty())
+            m_columnFormulas.insert(formula.first, makeColumnFormula(formula.second));
+    }
+}
+
+QList<QPair<int, QString>> LineModel::columnFormulas() const
+{
+    QList<QPair<int, QString>> formulas;
+    formulas.reserve(m_columnFormulas.size());
+    for(auto it= m_columnFormulas.constBegin(); it != m_columnFormulas.constEnd(); ++it)
+        formulas.append({it.key(), it.value().formula});
+    return formulas;
+}
+
+void LineModel::compileColumnFormula(ColumnFormula& formula) const
+{
+    formula.inputs.clear();
+    for(auto const& name : formula.names)
+        formula.inputs << columnIndex(name);
+    formula.compiled= !m_rows.isEmpty();
+}
+
+QString LineModel::computeCell(int row, ColumnFormula& formula)
+{
+    QStringList inputs;
+    inputs.reserve(formula.inputs.size());
+    for(auto column : formula.inputs)
+        inputs << (column < 0 ? QString() : cellValue(row, column));
+
+    // lines often share the same inputs (same item several times in an inventory).
+    auto const key= inputs.join(QChar(0x1f));
+    auto it= formula.results.constFind(key);
+    if(it != formula.results.constEnd())
+        return it.value();
+
+    if(nullptr == m_formulaManager)
+        m_formulaManager= new Formula::FormulaManager();
+
+    QHash<QString, QString> variables;
+    for(int i= 0; i < inputs.size(); ++i)
+        variables.insert(formula.names.at(i), inputs.at(i));
+    m_formulaManager->setConstantHash(variables);
+    auto result= m_formulaManager->getValue(formula.formula).toString();
+
+    if(formula.results.size() >= maxCachedResults)
+        formula.results.clear();
+    formula.results.insert(key, result);
+    return result;
+}
+
+void LineModel::computeColumn(int column)
+{
+    auto it= m_columnFormulas.find(column);
+    if(it == m_columnFormulas.end() || m_rows.isEmpty() || m_computingColumns.contains(column))
+        return;
+
+    if(!it->compiled)
+        compileColumnFormula(*it);
+
+    // the whole column is written before views and listeners are told, once.
+    auto const nested= !m_computingColumns.isEmpty();
+    QScopedValueRollback<bool> bulk(m_bulkUpdate, true);
+    m_computingColumns.insert(column);
+    auto const count= lineCount();
+    for(int row= 0; row < count; ++row)
+        writeCell(row, column, computeCell(row, *it));
+
+    for(auto dependent= m_columnFormulas.begin(); dependent != m_columnFormulas.end(); ++dependent)
+    {
+        if(m_computingColumns.contains(dependent.key()))
+            continue;
+        if(!dependent->compiled)
+            compileColumnFormula(*dependent);
+        if(dependent->inputs.contains(column))
+            computeColumn(dependent.key());
+    }
+    m_computingColumns.remove(column);
+
+    if(nested)
+        return;
+    if(m_fetchedCount > 0)
+        emit dataChanged(index(0), index(m_fetchedCount - 1));
+    emit contentChanged();
+}
+
+void LineModel::writeCell(int row, int column, const QString& value)
+{
+    auto& current= m_rows[row];
+    if(nullptr != current.line)
+    {
+        // bindings on the item are still notified, the model ignores its signals while m_bulkUpdate is set.
+        auto field= current.line->getField(column);
+        if(nullptr != field)
+            field->setValue(value, true);
+    }
+    else if(column < current.values.size())
+    {
+        current.values[column].value= value;
+    }
+    m_columns.setCell(row, column, value);
+}
+
+void LineModel::updateComputedCells(int row, int column)
+{
+    if(row < 0 || m_columnFormulas.isEmpty())
+        return;
+
+    // cells computed from another computed cell are notified by the first call.
+    auto const nested= !m_computingColumns.isEmpty();
+    bool computed= false;
+    for(auto it= m_columnFormulas.begin(); it != m_columnFormulas.end(); ++it)
+    {
+        // a column which depends on itself is not computed again.
+        if(m_computingColumns.contains(it.key()))
+            continue;
+
+        if(!it->compiled)
+            compileColumnFormula(*it);
+        if(!it->inputs.contains(column))
             continue;
 
-        sum+= field->value().toInt();
+        m_computingColumns.insert(it.key());
+        setCellValue(row, it.key(), computeCell(row, *it));
+        m_computingColumns.remove(it.key());
+        computed= true;
     }
-    return sum;
+
+    if(nested || !computed)
+        return;
+    if(row < m_fetchedCount)
+        emit dataChanged(index(row), index(row));
+    emit contentChanged();
+}
+
+QString LineModel::cellValue(int row, int column) const
+{
+    auto const& current= m_rows.at(row);
+    if(nullptr != current.line)
+    {
+        auto field= current.line->getField(column);
+        return nullptr == field ? QString() : field->value();
+    }
+
+    auto const& values= current.values;
+    return column < values.size() ? values.at(column).value : QString();
+}
+
+void LineModel::setCellValue(int row, int column, const QString& value)
+{
+    auto& current= m_rows[row];
+    if(nullptr != current.line)
+    {
+        // computed on every client, no need to send it.
+        auto field= current.line->getField(column);
+        if(nullptr != field)
+            field->setValue(value, true);
+        return;
+    }
+
+    auto& values= current.values;
+    if(column >= values.size() || values.at(column).value == value)
+        return;
+    values[column].value= value;
+    m_columns.setCell(row, column, value);
+    updateComputedCells(row, column);
 }
 ///////////////////////////////////
 /// \brief TableField::TableField
@@ -415,8 +1227,17 @@ void TableField::removeLine(int index)
 
 void TableField::removeLastLine()
 {
-    QModelIndex index;
-    m_model->removeLine(m_model->rowCount(index) - 1);
+    m_model->removeLine(m_model->lineCount() - 1);
+}
+
+void TableField::insertLines(int pos, int count)
+{
+    m_model->insertLines(pos, count, this);
+}
+
+void TableField::removeLines(int first, int last)
+{
+    m_model->removeLines(first, last);
 }
 
 void TableField::addLine()
@@ -502,6 +1323,16 @@ CharacterSheetItem* TableField::getChildFromId(const QString& id) const
     return m_model->getFieldById(id);
 }
 
+int TableField::indexOfChild(CharacterSheetItem* itm)
+{
+    return m_model->indexOfField(dynamic_cast<FieldController*>(itm));
+}
+
+QStringList TableField::childIds() const
+{
+    return m_model->cellIds();
+}
+
 CharacterSheetItem* TableField::getChildAt(int index) const
 {
     int itemPerLine= m_model->getColumnCount();
@@ -523,6 +1354,9 @@ void TableField::save(QJsonObject& json, bool exp)
         QJsonArray childArray;
         m_model->save(childArray);
         json["children"]= childArray;
+        QJsonArray formulaArray;
+        m_model->saveColumnFormulas(formulaArray);
+        json["columnFormulas"]= formulaArray;
         return;
     }
     json["type"]= "TableField";
@@ -568,6 +1402,10 @@ void TableField::save(QJsonObject& json, bool exp)
     m_model->save(childArray);
     json["children"]= childArray;
 
+    QJsonArray formulaArray;
+    m_model->saveColumnFormulas(formulaArray);
+    json["columnFormulas"]= formulaArray;
+
 #ifdef RCSE
     if(nullptr != m_tableCanvasField)
     {
@@ -637,6 +1475,7 @@ void TableField::load(const QJsonObject& json, EditorController* ctrl)
     QJsonArray childArray= json["children"].toArray();
 
     m_model->load(childArray, nullptr, this);
+    m_model->loadColumnFormulas(json["columnFormulas"].toArray());
 
 #ifdef RCSE
     if(json.contains("canvas"))
@@ -687,7 +1526,7 @@ int TableField::lineNumber() const
     if(nullptr == m_model)
         return -1;
 
-    return m_model->rowCount(QModelIndex());
+    return m_model->lineCount();
 }
 
 int TableField::itemPerLine() const
@@ -708,15 +1547,31 @@ void TableField::fillModel()
 
 void TableField::loadDataItem(const QJsonObject& json)
 {
-    m_id= json["id"].toString();
-    setValue(json["value"].toString(), true);
-    setLabel(json["label"].toString());
-    setFormula(json["formula"].toString());
-    setReadOnly(json["readonly"].toBool());
-    m_currentType= static_cast<FieldController::TypeField>(json["typefield"].toInt());
+    loadRecord(TableRecord::fromJson(json));
+}
 
-    QJsonArray childArray= json["children"].toArray();
-    m_model->loadDataItem(childArray, this);
+void TableField::loadRecord(const TableRecord& record)
+{
+    auto const& value= record.value;
+    setId(value.id);
+    setValue(value.value, true);
+    setLabel(value.label);
+    setFormula(value.formula);
+    setReadOnly(value.readOnly);
+    setCurrentType(value.typeField);
+
+    m_model->loadLines(record.lines, this);
+    m_model->loadColumnFormulas(record.columnFormulas);
+}
+
+TableRecord TableField::record() const
+{
+    TableRecord record;
+    record.value= FieldValue::fromItem(this);
+    record.value.type= QStringLiteral("TableField");
+    record.lines= m_model->lines();
+    record.columnFormulas= m_model->columnFormulas();
+    return record;
 }
 
 void TableField::setChildFieldData(const QJsonObject& json)
@@ -743,8 +1598,42 @@ void TableField::saveDataItem(QJsonObject& json)
     QJsonArray childArray;
     m_model->saveDataItem(childArray);
     json["children"]= childArray;
+
+    QJsonArray formulaArray;
+    m_model->saveColumnFormulas(formulaArray);
+    json["columnFormulas"]= formulaArray;
 }
 int TableField::sumColumn(const QString& name) const
 {
     return m_model->sumColumn(name);
 }
+
+int TableField::minColumn(const QString& name) const
+{
+    return m_model->columnAggregate(name).min;
+}
+
+int TableField::maxColumn(const QString& name) const
+{
+    return m_model->columnAggregate(name).max;
+}
+
+double TableField::avgColumn(const QString& name) const
+{
+    return m_model->columnAggregate(name).average();
+}
+
+int TableField::countColumn(const QString& name) const
+{
+    return m_model->columnAggregate(name).count;
+}
+
+void TableField::setColumnFormula(int column, const QString& formula)
+{
+    m_model->setColumnFormula(column, formula);
+}
+
+QString TableField::columnFormula(int column) const
+{
+    return m_model->columnFormula(column);
+}
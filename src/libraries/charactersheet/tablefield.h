@@ -23,10 +23,15 @@
 #define TABLEFIELD_H
 
 #include "charactersheet/charactersheetitem.h"
+#include "charactersheet/fieldvalue.h"
+#include "characterrecord.h"
+#include "columnstore.h"
 #include "field.h"
 #include <QGraphicsItem>
 #include <QLabel>
+#include <QMap>
 #include <QObject>
+#include <QSet>
 #include <QStandardItemModel>
 #include <QWidget>
 #ifdef RCSE
@@ -38,6 +43,10 @@ class TableCanvasField : public QGraphicsObject
 };
 #endif
 
+namespace Formula
+{
+class FormulaManager;
+}
 class TableField;
 /**
  * @brief The LineFieldItem class
@@ -64,9 +73,27 @@ public:
     void load(QJsonArray& json, EditorController* ctrl, CharacterSheetItem* parent);
     void saveDataItem(QJsonArray& json);
     void loadDataItem(QJsonArray& json, CharacterSheetItem* parent);
+    void loadDataItem(const QList<FieldValue>& values, CharacterSheetItem* parent);
+    void copyDataItem(const LineFieldItem* src, CharacterSheetItem* parent);
+    /**
+     * @brief row is the line of the item in its model, kept up to date by the model when lines move.
+     */
+    int row() const;
+    void setRow(int row);
+
+    static ObjectPool<LineFieldItem>& pool();
+    /**
+     * @brief dispose disconnects the line and its fields and deletes them later.
+     * QML and callers of getField may still hold them, they are never recycled for another line.
+     */
+    void dispose();
+
+private:
+    FieldController* createField(CharacterSheetItem* parent);
 
 private:
     QList<FieldController*> m_fields;
+    int m_row= -1;
 };
 
 /**
@@ -80,29 +107,170 @@ public:
     {
         LineRole= Qt::UserRole + 1
     };
+    using ColumnAggregate= ::ColumnAggregate;
     LineModel();
+    ~LineModel();
     int rowCount(const QModelIndex& parent) const;
+    /**
+     * @brief canFetchMore lines loaded from data are given to the view by batch when it scrolls to them.
+     * Lines are built when they are asked for, the least recently used ones go back to plain values.
+     */
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
     QVariant data(const QModelIndex& index, int role) const;
+    void multiData(const QModelIndex& index, QModelRoleDataSpan roleDataSpan) const override;
     bool setData(const QModelIndex& index, const QVariant& data, int role);
     QHash<int, QByteArray> roleNames() const;
     void insertLine(LineFieldItem* line);
     void appendLine(TableField* field);
+    /**
+     * @brief insertLines adds count copies of the last line at pos with a single notification.
+     */
+    void insertLines(int pos, int count, TableField* field);
     void clear();
     int getChildrenCount() const;
+    /**
+     * @brief lineCount counts every line, rowCount only the ones given to the view so far.
+     */
+    int lineCount() const;
     int getColumnCount() const;
     FieldController* getField(int line, int col);
+    /**
+     * @brief getFieldById gives the cell of the first line which has this id, lines added later share the ids.
+     */
     FieldController* getFieldById(const QString& id);
+    FieldController* getFieldById(int line, const QString& id);
+    /**
+     * @brief lineOfField gives the line of a built cell, -1 when the cell is not in the table.
+     */
+    int lineOfField(const FieldController* field);
+    /**
+     * @brief indexOfField gives the child index (line * column count + column) of a built cell.
+     * Cells got from the model are only valid until the event loop runs again, their line may be compacted.
+     */
+    int indexOfField(const FieldController* field);
+    /**
+     * @brief cellIds gives the id of every cell in child order, compact lines are read without being built.
+     */
+    QStringList cellIds() const;
     void removeLine(int index);
+    void removeLines(int first, int last);
     void save(QJsonArray& json);
     void load(const QJsonArray& json, EditorController* ctrl, CharacterSheetItem* parent);
     void saveDataItem(QJsonArray& json);
-    void loadDataItem(const QJsonArray& json, CharacterSheetItem* parent);
+    /**
+     * @brief loadLines resets the model with lines decoded beforehand, no item is built.
+     */
+    void loadLines(const QList<QList<FieldValue>>& lines, CharacterSheetItem* parent);
+    void copyDataItem(const LineModel* src, CharacterSheetItem* parent);
+    /**
+     * @brief setChildFieldData updates the cell with the id of json on its "line", on the first line if not given.
+     */
     void setChildFieldData(const QJsonObject& json);
     int sumColumn(const QString& name) const;
+    ColumnAggregate columnAggregate(const QString& name) const;
+    int columnIndex(const QString& name) const;
     void setFieldInDictionnary(QHash<QString, QString>& dict, const QString& id, const QString& label) const;
+    /**
+     * @brief setColumnFormula computes the column of every line from the other cells of the same line.
+     * References (${name}) are column labels or ids. An empty formula removes the computed column.
+     */
+    void setColumnFormula(int column, const QString& formula);
+    QString columnFormula(int column) const;
+    void saveColumnFormulas(QJsonArray& json) const;
+    void loadColumnFormulas(const QJsonArray& json);
+    void loadColumnFormulas(const QList<QPair<int, QString>>& formulas);
+    QList<QPair<int, QString>> columnFormulas() const;
+    /**
+     * @brief lines copies the values of every line, compact lines are shared without being built.
+     */
+    QList<QList<FieldValue>> lines() const;
+
+signals:
+    /**
+     * @brief contentChanged is emitted when the saved content of the table changes, compact lines included.
+     */
+    void contentChanged();
+    /**
+     * @brief lineCountChanged is emitted when lines are added or removed, rowsInserted only covers fetched lines.
+     */
+    void lineCountChanged();
+    /**
+     * @brief linesCompacted is emitted when built lines go back to plain values, their cells are deleted later.
+     */
+    void linesCompacted();
+
+private:
+    struct ColumnFormula
+    {
+        QString formula;
+        QStringList names;
+        QList<int> inputs;
+        bool compiled= false;
+        QHash<QString, QString> results;
+    };
+    static ColumnFormula makeColumnFormula(const QString& formula);
+    void compileColumnFormula(ColumnFormula& formula) const;
+    QString computeCell(int row, ColumnFormula& formula);
+    /**
+     * @brief computeColumn writes every cell of the column, then the columns computed from it, with one notification.
+     */
+    void computeColumn(int column);
+    void writeCell(int row, int column, const QString& value);
+    void updateComputedCells(int row, int column);
+    QString cellValue(int row, int column) const;
+    void setCellValue(int row, int column, const QString& value);
+
+private:
+    void releaseLines();
+    void trackLine(LineFieldItem* line, int row, bool newRow= true);
+    void untrackLine(LineFieldItem* line);
+    QList<FieldValue> lineValues(int row) const;
+    void insertCompactLine(int row, const QList<FieldValue>& values);
+    void updateRows(int first);
+    LineFieldItem* lineAt(int row) const;
+    LineFieldItem* buildLine(int row);
+    void compactLines();
+    void fetchLines(int count);
+    void fetchUpTo(int lineCount);
+    void resetAggregates();
+    const ColumnAggregate& aggregate(int column) const;
+    void rebuildCellIndex();
 
 private:
-    QList<LineFieldItem*> m_lines;
+    /**
+     * @brief The CellIndex struct locates the cell of the first line with an id, ids are duplicated between lines.
+     */
+    struct CellIndex
+    {
+        int row= -1;
+        int column= -1;
+    };
+    void indexCell(int row, int column, const QString& id);
+    /**
+     * @brief The Row struct holds either a built line or the plain values of a compact one.
+     */
+    struct Row
+    {
+        LineFieldItem* line= nullptr;
+        QList<FieldValue> values;
+        quint64 lastUse= 0;
+    };
+    QList<Row> m_rows;
+    int m_fetchedCount= 0;
+    int m_builtCount= 0;
+    quint64 m_useClock= 0;
+    bool m_compactionScheduled= false;
+    CharacterSheetItem* m_parent= nullptr;
+    ColumnStore m_columns;
+    mutable QHash<QString, int> m_columnByName;
+    QHash<QString, CellIndex> m_cellById;
+    QHash<QPair<int, QString>, int> m_columnByCell;
+    bool m_cellIndexDirty= false;
+    QMap<int, ColumnFormula> m_columnFormulas;
+    QSet<int> m_computingColumns;
+    bool m_bulkUpdate= false;
+    Formula::FormulaManager* m_formulaManager= nullptr;
 };
 
 /**
@@ -143,6 +311,11 @@ public:
     virtual int getChildrenCount() const override;
     virtual CharacterSheetItem* getChildFromId(const QString& id) const override;
     virtual CharacterSheetItem* getChildAt(int) const override;
+    virtual int indexOfChild(CharacterSheetItem* itm) override;
+    /**
+     * @brief childIds gives the ids of the children without building them, it may be called from any thread.
+     */
+    QStringList childIds() const;
     virtual void save(QJsonObject& json, bool exp= false) override;
     virtual void load(const QJsonObject& json, EditorController* ctrl) override;
     virtual void copyField(CharacterSheetItem* oldItem, bool copyData, bool sameId= true);
@@ -153,6 +326,14 @@ public:
     virtual CharacterSheetItem::CharacterSheetItemType getItemType() const override;
     void saveDataItem(QJsonObject& json) override;
     void loadDataItem(const QJsonObject& json) override;
+    /**
+     * @brief loadRecord loads a table decoded on a worker thread, only the field itself is set on this thread.
+     */
+    void loadRecord(const TableRecord& record);
+    /**
+     * @brief record copies the table as plain values, it can then be serialized on another thread.
+     */
+    TableRecord record() const;
     void setChildFieldData(const QJsonObject& json);
 
     int getMaxVisibleRowCount() const;
@@ -163,12 +344,20 @@ public:
     int itemPerLine() const;
 
     Q_INVOKABLE int sumColumn(const QString& name) const;
+    Q_INVOKABLE int minColumn(const QString& name) const;
+    Q_INVOKABLE int maxColumn(const QString& name) const;
+    Q_INVOKABLE double avgColumn(const QString& name) const;
+    Q_INVOKABLE int countColumn(const QString& name) const;
+    Q_INVOKABLE void setColumnFormula(int column, const QString& formula);
+    Q_INVOKABLE QString columnFormula(int column) const;
     void setFieldInDictionnary(QHash<QString, QString>& dict) const override;
 
 public slots:
     void addLine();
     void removeLine(int line);
     void removeLastLine();
+    void insertLines(int pos, int count);
+    void removeLines(int first, int last);
 
 signals:
     void lineMustBeAdded(TableField* table);
@@ -5,6 +5,12 @@
 
 SheetWidget::SheetWidget(QWidget* parent) : QQuickWidget(parent) {}
 
+SheetWidget::~SheetWidget()
+{
+    if(nullptr != m_characterSheet)
+        m_characterSheet->releaseItems();
+}
+
 void SheetWidget::mousePressEvent(QMouseEvent* event)
 {
     QQuickWidget::mousePressEvent(event);
@@ -18,7 +24,14 @@ void SheetWidget::setSheet(CharacterSheet* sheet)
     if(sheet == m_characterSheet)
         return;
 
+    // the qml context binds to items, they only exist while a widget shows the sheet.
+    if(nullptr != m_characterSheet)
+        m_characterSheet->releaseItems();
+
     m_characterSheet= sheet;
+
+    if(nullptr != m_characterSheet)
+        m_characterSheet->acquireItems();
     emit sheetChanged();
 }
 CharacterSheet* SheetWidget::sheet() const
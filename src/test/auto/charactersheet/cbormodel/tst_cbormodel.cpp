@@ -0,0 +1,133 @@
+#include <QCborStreamReader>
+#include <QCborStreamWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "testfixtures.h"
+
+namespace
+{
+using Fixtures::field;
+
+QJsonObject structure()
+{
+    QJsonArray line{field("id_3_1", "Item", ""), field("id_3_2", "Count", "")};
+    auto const table= Fixtures::table("id_3", "Inventory", QJsonArray{line});
+    return Fixtures::rootSection(QJsonArray{field("id_1", "Strength", "10"), field("id_2", "Bonus", ""), table});
+}
+
+QJsonObject character(const QString& name, const QString& uuid, int strength, int lineCount)
+{
+    QJsonArray lines;
+    for(int i= 0; i < lineCount; ++i)
+        lines.append(QJsonArray{field("id_3_1", "Item", QStringLiteral("item %1").arg(i)),
+                                field("id_3_2", "Count", QString::number(i + 1))});
+    QJsonObject values{{"id_1", field("id_1", "Strength", QString::number(strength))},
+                       {"id_2", field("id_2", "Bonus", QString::number(strength - 10), "=${Strength}-10")},
+                       {"id_3", Fixtures::table("id_3", "Inventory", lines)}};
+    return Fixtures::character(name, uuid, values);
+}
+
+QJsonArray characters()
+{
+    return {character("Aragorn", "{2f1c7d3e-6a55-4f5c-9d61-0c1c5b9a8e01}", 18, 3),
+            character("Gimli", "{8a0e4b52-1d2f-4c3b-a6e7-93b1f0c2d402}", 16, 0),
+            character("Legolas", "{c5d9f6a1-7e3b-4a28-b0c4-5e6f7a8b9c03}", 14, 60)};
+}
+
+QByteArray toCbor(CharacterSheetModel& model)
+{
+    QByteArray data;
+    QCborStreamWriter writer(&data);
+    model.writeModel(writer, true);
+    return data;
+}
+
+QByteArray saved(CharacterSheet* sheet)
+{
+    QJsonObject json;
+    sheet->save(json);
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+void compareModels(CharacterSheetModel& expected, CharacterSheetModel& actual)
+{
+    QCOMPARE(actual.getCharacterSheetCount(), expected.getCharacterSheetCount());
+    for(int i= 0; i < expected.getCharacterSheetCount(); ++i)
+    {
+        auto expectedSheet= expected.getCharacterSheet(i);
+        auto actualSheet= actual.getCharacterSheet(i);
+        QVERIFY(nullptr != actualSheet);
+        QCOMPARE(actualSheet->name(), expectedSheet->name());
+        QCOMPARE(actualSheet->uuid(), expectedSheet->uuid());
+        QCOMPARE(saved(actualSheet), saved(expectedSheet));
+    }
+}
+} // namespace
+
+class CborModelTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTripTest();
+    void pendingCharacterTest();
+    void truncatedTest();
+};
+
+void CborModelTest::roundTripTest()
+{
+    CharacterSheetModel model;
+    model.readModel(QJsonObject{{"data", structure()}, {"characters", characters()}}, true);
+    QCOMPARE(model.getCharacterSheetCount(), 3);
+
+    auto const data= toCbor(model);
+    QVERIFY(!data.isEmpty());
+
+    CharacterSheetModel loaded;
+    loaded.loadRootSection(structure());
+    QCborStreamReader reader(data);
+    QVERIFY(loaded.readModel(reader, false));
+    compareModels(model, loaded);
+}
+
+void CborModelTest::pendingCharacterTest()
+{
+    // characters not built yet are written from their json.
+    CharacterSheetModel model;
+    model.beginLoading();
+    model.loadRootSection(structure());
+    for(auto const& value : characters())
+        model.loadCharacterLater(QJsonDocument(value.toObject()).toJson(QJsonDocument::Compact));
+    model.endLoading();
+    auto const data= toCbor(model);
+
+    CharacterSheetModel reference;
+    reference.readModel(QJsonObject{{"data", structure()}, {"characters", characters()}}, true);
+
+    CharacterSheetModel loaded;
+    loaded.loadRootSection(structure());
+    QCborStreamReader reader(data);
+    QVERIFY(loaded.readModel(reader, false));
+    compareModels(reference, loaded);
+}
+
+void CborModelTest::truncatedTest()
+{
+    CharacterSheetModel model;
+    model.readModel(QJsonObject{{"data", structure()}, {"characters", characters()}}, true);
+    auto const data= toCbor(model);
+
+    CharacterSheetModel loaded;
+    loaded.loadRootSection(structure());
+    QCborStreamReader reader(data.left(data.size() / 2));
+    QVERIFY(!loaded.readModel(reader, false));
+}
+
+QTEST_MAIN(CborModelTest)
+
+#include "tst_cbormodel.moc"
@@ -0,0 +1,213 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "charactersheet/changejournal.h"
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "testfixtures.h"
+
+namespace
+{
+using Fixtures::field;
+
+QJsonObject character(const QString& name, const QString& uuid)
+{
+    QJsonObject values{{"id_1", field("id_1", "Name", name)}, {"id_2", field("id_2", "Strength", "10")}};
+    return Fixtures::character(name, uuid, values);
+}
+
+QJsonObject file()
+{
+    return Fixtures::file(QJsonArray{field("id_1", "Name", ""), field("id_2", "Strength", "")},
+                          QJsonArray{character("Frodo", "{7c3e9a10-2b4d-4f6e-8a1c-5d7e9f0a1b01}"),
+                                     character("Sam", "{7c3e9a10-2b4d-4f6e-8a1c-5d7e9f0a1b02}")});
+}
+
+// rows follow the root section: name then strength, column 1 is the first character.
+bool edit(CharacterSheetModel& model, int row, int character, const QString& value)
+{
+    return model.setData(model.index(row, character + 1), value, Qt::EditRole);
+}
+
+QString value(CharacterSheetModel& model, int character, const QString& id)
+{
+    return model.getCharacterSheet(character)->getValue(id).toString();
+}
+
+qint64 journalSize(const QString& rcsPath)
+{
+    return QFileInfo(ChangeJournal::journalPath(rcsPath)).size();
+}
+} // namespace
+
+class ChangeJournalTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void replayTest();
+    void formulaTest();
+    void truncatedTest();
+    void compactTest();
+};
+
+void ChangeJournalTest::replayTest()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const rcsPath= dir.filePath("sheet.rcs");
+
+    CharacterSheetModel model;
+    model.readModel(file(), true);
+    ChangeJournal journal(&model);
+    QVERIFY(journal.open(rcsPath));
+    QVERIFY(edit(model, 1, 0, "18"));
+    QVERIFY(edit(model, 0, 1, "Samwise"));
+    QVERIFY(journal.flush());
+    journal.close();
+    auto const size= journalSize(rcsPath);
+    QVERIFY(size > 0);
+
+    // the .rcs file is loaded first, then the journal brings the editions back.
+    CharacterSheetModel loaded;
+    loaded.readModel(file(), true);
+    ChangeJournal reader(&loaded);
+    QVERIFY(reader.open(rcsPath));
+    QCOMPARE(reader.replay(), 2);
+    QCOMPARE(value(loaded, 0, "id_2"), QStringLiteral("18"));
+    QCOMPARE(value(loaded, 1, "id_1"), QStringLiteral("Samwise"));
+    QCOMPARE(value(loaded, 0, "id_1"), QStringLiteral("Frodo"));
+    QCOMPARE(value(loaded, 1, "id_2"), QStringLiteral("10"));
+
+    // replayed editions are not recorded again.
+    reader.flush();
+    QCOMPARE(journalSize(rcsPath), size);
+    QVERIFY(reader.errorString().isEmpty());
+}
+
+void ChangeJournalTest::formulaTest()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const rcsPath= dir.filePath("sheet.rcs");
+
+    // the formula gives the value the field already has, only the formula changes.
+    CharacterSheetModel model;
+    model.readModel(file(), true);
+    ChangeJournal journal(&model);
+    QVERIFY(journal.open(rcsPath));
+    QVERIFY(edit(model, 1, 0, "=5+5"));
+    QCOMPARE(value(model, 0, "id_2"), QStringLiteral("10"));
+    QVERIFY(journal.flush());
+    QVERIFY(journalSize(rcsPath) > 0);
+
+    CharacterSheetModel loaded;
+    loaded.readModel(file(), true);
+    ChangeJournal reader(&loaded);
+    QVERIFY(reader.open(rcsPath));
+    QCOMPARE(reader.replay(), 1);
+    auto item= loaded.getCharacterSheet(0)->getFieldFromKey("id_2");
+    QVERIFY(nullptr != item);
+    QCOMPARE(item->getFormula(), QStringLiteral("=5+5"));
+    QCOMPARE(item->value(), QStringLiteral("10"));
+}
+
+void ChangeJournalTest::truncatedTest()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const rcsPath= dir.filePath("sheet.rcs");
+
+    CharacterSheetModel model;
+    model.readModel(file(), true);
+    ChangeJournal journal(&model);
+    QVERIFY(journal.open(rcsPath));
+    QVERIFY(edit(model, 1, 0, "12"));
+    QVERIFY(journal.flush());
+    auto const validSize= journalSize(rcsPath);
+    QVERIFY(edit(model, 1, 1, "14"));
+    QVERIFY(journal.flush());
+    journal.close();
+
+    // a crash cuts the last record.
+    QVERIFY(QFile::resize(ChangeJournal::journalPath(rcsPath), journalSize(rcsPath) - 2));
+
+    CharacterSheetModel loaded;
+    loaded.readModel(file(), true);
+    ChangeJournal reader(&loaded);
+    QVERIFY(reader.open(rcsPath));
+    QCOMPARE(reader.replay(), 1);
+    QCOMPARE(value(loaded, 0, "id_2"), QStringLiteral("12"));
+    QCOMPARE(value(loaded, 1, "id_2"), QStringLiteral("10"));
+    QCOMPARE(journalSize(rcsPath), validSize);
+
+    // new records follow the last valid one.
+    QVERIFY(edit(loaded, 0, 1, "Samwise"));
+    QVERIFY(reader.flush());
+    reader.close();
+
+    CharacterSheetModel again;
+    again.readModel(file(), true);
+    ChangeJournal last(&again);
+    QVERIFY(last.open(rcsPath));
+    QCOMPARE(last.replay(), 2);
+    QCOMPARE(value(again, 0, "id_2"), QStringLiteral("12"));
+    QCOMPARE(value(again, 1, "id_1"), QStringLiteral("Samwise"));
+}
+
+void ChangeJournalTest::compactTest()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    auto const rcsPath= dir.filePath("sheet.rcs");
+
+    CharacterSheetModel model;
+    model.readModel(file(), true);
+    ChangeJournal journal(&model);
+    QVERIFY(journal.open(rcsPath));
+    QVERIFY(edit(model, 1, 0, "16"));
+    QVERIFY(journal.flush());
+
+    auto snapshot= file();
+    snapshot.insert("compacted", true);
+    auto future= journal.compact(snapshot);
+    // an edition made while the snapshot is written stays in the journal.
+    QVERIFY(edit(model, 0, 0, "Frodo Baggins"));
+    QTRY_VERIFY(future.isFinished());
+    QVERIFY(future.result());
+    QVERIFY(journal.errorString().isEmpty());
+
+    QFile rcs(rcsPath);
+    QVERIFY(rcs.open(QIODevice::ReadOnly));
+    QCOMPARE(QJsonDocument::fromJson(rcs.readAll()).object(), snapshot);
+
+    CharacterSheetModel loaded;
+    loaded.readModel(file(), true);
+    ChangeJournal reader(&loaded);
+    QVERIFY(reader.open(rcsPath));
+    QCOMPARE(reader.replay(), 1);
+    QCOMPARE(value(loaded, 0, "id_1"), QStringLiteral("Frodo Baggins"));
+    QCOMPARE(value(loaded, 0, "id_2"), QStringLiteral("10"));
+    reader.close();
+
+    // the journal is still written after the compaction.
+    QVERIFY(edit(model, 1, 1, "9"));
+    QVERIFY(journal.flush());
+    journal.close();
+
+    CharacterSheetModel last;
+    last.readModel(file(), true);
+    ChangeJournal lastReader(&last);
+    QVERIFY(lastReader.open(rcsPath));
+    QCOMPARE(lastReader.replay(), 2);
+    QCOMPARE(value(last, 1, "id_2"), QStringLiteral("9"));
+}
+
+QTEST_MAIN(ChangeJournalTest)
+
+#include "tst_changejournal.moc"
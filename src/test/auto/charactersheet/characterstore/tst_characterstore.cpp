@@ -0,0 +1,241 @@
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "characterstore.h"
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "testfixtures.h"
+
+namespace
+{
+QString uuidOf(int i)
+{
+    return QStringLiteral("{6f1e2d3c-4b5a-4968-8776-%1}").arg(i, 12, 10, QChar('0'));
+}
+
+QByteArray character(int i)
+{
+    auto const name= QStringLiteral("npc %1").arg(i);
+    return Fixtures::compact(
+        Fixtures::character(name, uuidOf(i), QJsonObject{{"id_1", Fixtures::field("id_1", "Name", name)}}));
+}
+
+QJsonObject structure()
+{
+    return Fixtures::rootSection(QJsonArray{Fixtures::field("id_1", "Name", "")});
+}
+
+void deleteEvicted()
+{
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+}
+} // namespace
+
+class CharacterStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void lazyTest();
+    void uuidTest();
+    void evictionTest();
+    void evictorTest();
+    void modelEvictionTest();
+};
+
+void CharacterStoreTest::lazyTest()
+{
+    int built= 0;
+    CharacterStore store(
+        [&built](const QByteArray& json)
+        {
+            ++built;
+            auto sheet= new CharacterSheet();
+            sheet->load(QJsonDocument::fromJson(json).object());
+            return sheet;
+        });
+    for(int i= 0; i < 10; ++i)
+        store.appendPending(character(i), uuidOf(i));
+
+    QCOMPARE(store.size(), 10);
+    QCOMPARE(built, 0);
+    QVERIFY(store.loadedSheets().isEmpty());
+    QCOMPARE(store.pendingData(3), character(3));
+
+    // only the requested character is built, once.
+    auto sheet= store.at(3);
+    QVERIFY(nullptr != sheet);
+    QCOMPARE(sheet->name(), QStringLiteral("npc 3"));
+    QCOMPARE(store.at(3), sheet);
+    QCOMPARE(built, 1);
+    QVERIFY(store.isLoaded(3));
+    QVERIFY(!store.isLoaded(4));
+    QCOMPARE(store.indexOf(sheet), 3);
+    QCOMPARE(store.loadedSheets().size(), 1);
+}
+
+void CharacterStoreTest::uuidTest()
+{
+    int built= 0;
+    CharacterStore store(
+        [&built](const QByteArray& json)
+        {
+            ++built;
+            auto sheet= new CharacterSheet();
+            sheet->load(QJsonDocument::fromJson(json).object());
+            return sheet;
+        });
+    for(int i= 0; i < 5; ++i)
+        store.appendPending(character(i), uuidOf(i));
+    store.appendPending(character(5), QStringLiteral("old-id"));
+
+    // uuids are compared as values, without reading nor building any character.
+    QCOMPARE(store.indexOfUnloaded(uuidOf(2)), 2);
+    auto unbraced= uuidOf(4);
+    unbraced.remove('{').remove('}');
+    QCOMPARE(store.indexOfUnloaded(unbraced), 4);
+    QCOMPARE(store.indexOfUnloaded(uuidOf(4).toUpper()), 4);
+    QCOMPARE(store.indexOfUnloaded(QStringLiteral("old-id")), 5);
+    QCOMPARE(store.indexOfUnloaded(uuidOf(9)), -1);
+    QCOMPARE(store.indexOfUnloaded(QString()), -1);
+    QCOMPARE(built, 0);
+
+    store.at(2);
+    QCOMPARE(store.indexOfUnloaded(uuidOf(2)), -1);
+
+    // the index follows the slots when they move.
+    QCOMPARE(store.takeAt(0), nullptr);
+    QCOMPARE(store.indexOfUnloaded(uuidOf(4)), 3);
+    QCOMPARE(store.indexOfUnloaded(QStringLiteral("old-id")), 4);
+    store.insert(0, new CharacterSheet());
+    QCOMPARE(store.indexOfUnloaded(uuidOf(4)), 4);
+    QCOMPARE(store.indexOfUnloaded(uuidOf(0)), -1);
+    QCOMPARE(built, 1);
+}
+
+void CharacterStoreTest::evictionTest()
+{
+    int built= 0;
+    CharacterStore store(
+        [&built](const QByteArray& json)
+        {
+            ++built;
+            auto sheet= new CharacterSheet();
+            sheet->load(QJsonDocument::fromJson(json).object());
+            return sheet;
+        });
+    for(int i= 0; i < 6; ++i)
+        store.appendPending(character(i), uuidOf(i));
+
+    QList<QPointer<CharacterSheet>> sheets;
+    for(int i= 0; i < 6; ++i)
+        sheets << store.at(i);
+    store.markModified(sheets.at(0));
+    auto const cost= store.residentCost();
+    QVERIFY(cost > 0);
+
+    // least recently used clean characters go first, the modified one stays.
+    store.at(1);
+    store.setMemoryBudget(cost / 3);
+    QVERIFY(store.residentCost() <= cost / 3);
+    QVERIFY(store.isLoaded(0));
+    QVERIFY(!store.isLoaded(2));
+    deleteEvicted();
+    QVERIFY(sheets.at(0));
+    QVERIFY(!sheets.at(2));
+
+    // evicted characters are found from their uuid and built again from the cache.
+    QCOMPARE(store.indexOfUnloaded(uuidOf(2)), 2);
+    auto rebuilt= store.at(2);
+    QVERIFY(nullptr != rebuilt);
+    QCOMPARE(rebuilt->name(), QStringLiteral("npc 2"));
+    QCOMPARE(rebuilt->uuid(), uuidOf(2));
+    QCOMPARE(rebuilt->getValue("id_1").toString(), QStringLiteral("npc 2"));
+    QCOMPARE(built, 7);
+    QCOMPARE(store.size(), 6);
+
+    // once saved, the modified character may go too.
+    store.markSaved();
+    store.setMemoryBudget(1);
+    QVERIFY(!store.isLoaded(0));
+    deleteEvicted();
+    QVERIFY(!sheets.at(0));
+}
+
+void CharacterStoreTest::evictorTest()
+{
+    CharacterStore store(
+        [](const QByteArray& json)
+        {
+            auto sheet= new CharacterSheet();
+            sheet->load(QJsonDocument::fromJson(json).object());
+            return sheet;
+        });
+    for(int i= 0; i < 4; ++i)
+        store.appendPending(character(i), uuidOf(i));
+    for(int i= 0; i < 4; ++i)
+        store.at(i);
+
+    // a character in use is kept whatever the budget.
+    auto const inUse= store.at(1);
+    int released= 0;
+    store.setEvictor([inUse](CharacterSheet* sheet) { return sheet != inUse; },
+                     [&released, inUse](CharacterSheet* sheet)
+                     {
+                         QVERIFY(sheet != inUse);
+                         ++released;
+                     });
+    store.setMemoryBudget(1);
+    QCOMPARE(released, 3);
+    QVERIFY(store.isLoaded(1));
+    QVERIFY(!store.isLoaded(0));
+    QVERIFY(!store.isLoaded(2));
+    QVERIFY(!store.isLoaded(3));
+    deleteEvicted();
+}
+
+void CharacterStoreTest::modelEvictionTest()
+{
+    CharacterSheetModel model;
+    model.beginLoading();
+    model.loadRootSection(structure());
+    for(int i= 0; i < 8; ++i)
+        model.loadCharacterLater(character(i));
+    model.endLoading();
+    QCOMPARE(model.getCharacterSheetCount(), 8);
+
+    for(int column= 1; column <= 8; ++column)
+        QCOMPARE(model.data(model.index(0, column)).toString(), QStringLiteral("npc %1").arg(column - 1));
+    QCoreApplication::processEvents();
+
+    // a character given to the caller is not evicted until the event loop runs, the ones read by views are.
+    QSignalSpy evicted(&model, &CharacterSheetModel::characterSheetEvicted);
+    QPointer<CharacterSheet> kept= model.getCharacterSheet(0);
+    model.setMemoryBudget(1);
+    deleteEvicted();
+
+    QVERIFY(kept);
+    QCOMPARE(evicted.size(), 7);
+    for(auto const& arguments : std::as_const(evicted))
+        QVERIFY(arguments.at(0).value<CharacterSheet*>() != kept.data());
+
+    QCoreApplication::processEvents();
+    deleteEvicted();
+    QVERIFY(!kept);
+
+    auto unbraced= uuidOf(5);
+    unbraced.remove('{').remove('}');
+    auto sheet= model.getCharacterSheetById(unbraced);
+    QVERIFY(nullptr != sheet);
+    QCOMPARE(sheet->name(), QStringLiteral("npc 5"));
+    QCOMPARE(model.getCharacterSheetById(uuidOf(0))->name(), QStringLiteral("npc 0"));
+}
+
+QTEST_MAIN(CharacterStoreTest)
+
+#include "tst_characterstore.moc"
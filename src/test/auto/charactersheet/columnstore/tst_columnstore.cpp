@@ -0,0 +1,199 @@
+#include <QRandomGenerator>
+#include <QTest>
+
+#include "columnstore.h"
+
+namespace
+{
+// aggregate computed from scratch, the store must give the same one whatever the order of the changes.
+ColumnAggregate expectedAggregate(const QList<QStringList>& rows, int column)
+{
+    ColumnAggregate agg;
+    bool first= true;
+    for(auto const& row : rows)
+    {
+        bool ok= false;
+        auto const value= column < row.size() ? row.at(column).toInt(&ok) : 0;
+        if(!ok)
+            continue;
+        agg.sum+= value;
+        ++agg.count;
+        agg.min= first ? value : std::min(agg.min, value);
+        agg.max= first ? value : std::max(agg.max, value);
+        first= false;
+    }
+    return agg;
+}
+
+void compare(const ColumnStore& store, const QList<QStringList>& rows, int columnCount)
+{
+    QCOMPARE(store.rowCount(), static_cast<int>(rows.size()));
+    for(int column= 0; column < columnCount; ++column)
+    {
+        auto const expected= expectedAggregate(rows, column);
+        auto const& agg= store.aggregate(column);
+        QCOMPARE(agg.count, expected.count);
+        QCOMPARE(agg.sum, expected.sum);
+        if(expected.count > 0)
+        {
+            QCOMPARE(agg.min, expected.min);
+            QCOMPARE(agg.max, expected.max);
+        }
+    }
+}
+} // namespace
+
+class ColumnStoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void insertTest();
+    void removeTest();
+    void editTest();
+    void notNumberTest();
+    void randomTest();
+};
+
+void ColumnStoreTest::insertTest()
+{
+    ColumnStore store;
+    QList<QStringList> rows;
+    rows << QStringList{"3", "10"} << QStringList{"-2", "4"};
+    store.appendRow(rows.at(0));
+    store.appendRow(rows.at(1));
+    compare(store, rows, 2);
+
+    // the first aggregate is known, the next ones are updated.
+    rows.insert(1, {"7", "-5"});
+    store.insertRow(1, rows.at(1));
+    compare(store, rows, 2);
+
+    rows.insert(0, {"100", "0"});
+    store.insertRow(0, rows.at(0));
+    compare(store, rows, 2);
+    QCOMPARE(store.aggregate(0).average(), 27.);
+}
+
+void ColumnStoreTest::removeTest()
+{
+    ColumnStore store;
+    QList<QStringList> rows;
+    for(auto const& value : {"5", "1", "9", "1", "9", "4"})
+        rows << QStringList{value};
+    for(auto const& row : rows)
+        store.appendRow(row);
+    compare(store, rows, 1);
+
+    // one of the two min and max values goes away, the other one still holds.
+    store.removeRow(1);
+    rows.removeAt(1);
+    compare(store, rows, 1);
+    store.removeRow(1);
+    rows.removeAt(1);
+    compare(store, rows, 1);
+
+    store.removeRows(0, 2);
+    rows.remove(0, 3);
+    compare(store, rows, 1);
+    QCOMPARE(store.aggregate(0).min, 4);
+    QCOMPARE(store.aggregate(0).max, 4);
+
+    store.removeRows(0, 0);
+    rows.clear();
+    compare(store, rows, 1);
+    QCOMPARE(store.aggregate(0).count, 0);
+}
+
+void ColumnStoreTest::editTest()
+{
+    ColumnStore store;
+    QList<QStringList> rows;
+    rows << QStringList{"2"} << QStringList{"8"} << QStringList{"5"};
+    for(auto const& row : rows)
+        store.appendRow(row);
+
+    store.setCell(1, 0, "3");
+    rows[1][0]= "3";
+    compare(store, rows, 1);
+
+    store.setCell(2, 0, "-1");
+    rows[2][0]= "-1";
+    compare(store, rows, 1);
+
+    store.setCell(0, 0, "20");
+    rows[0][0]= "20";
+    compare(store, rows, 1);
+    QCOMPARE(store.aggregate(0).max, 20);
+    QCOMPARE(store.aggregate(0).min, -1);
+}
+
+void ColumnStoreTest::notNumberTest()
+{
+    ColumnStore store;
+    QList<QStringList> rows;
+    rows << QStringList{"sword", "1"} << QStringList{"", "2"} << QStringList{"12", "x"};
+    for(auto const& row : rows)
+        store.appendRow(row);
+    compare(store, rows, 2);
+    QCOMPARE(store.aggregate(0).count, 1);
+
+    // a number turned into text leaves the aggregate.
+    store.setCell(2, 0, "twelve");
+    rows[2][0]= "twelve";
+    compare(store, rows, 2);
+    QCOMPARE(store.aggregate(0).count, 0);
+
+    store.setCell(0, 1, "shield");
+    rows[0][1]= "shield";
+    compare(store, rows, 2);
+}
+
+void ColumnStoreTest::randomTest()
+{
+    QRandomGenerator random(42);
+    ColumnStore store;
+    QList<QStringList> rows;
+    constexpr int columnCount= 3;
+    auto randomRow= [&random]()
+    {
+        QStringList row;
+        for(int i= 0; i < columnCount; ++i)
+            row << (random.bounded(5) == 0 ? QStringLiteral("n/a") : QString::number(random.bounded(-50, 50)));
+        return row;
+    };
+
+    for(int step= 0; step < 2000; ++step)
+    {
+        auto const action= rows.isEmpty() ? 0 : random.bounded(4);
+        if(action == 0)
+        {
+            auto const row= random.bounded(static_cast<int>(rows.size()) + 1);
+            rows.insert(row, randomRow());
+            store.insertRow(row, rows.at(row));
+        }
+        else if(action == 1)
+        {
+            auto const first= random.bounded(static_cast<int>(rows.size()));
+            auto const last= std::min(first + random.bounded(3), static_cast<int>(rows.size()) - 1);
+            rows.remove(first, last - first + 1);
+            store.removeRows(first, last);
+        }
+        else
+        {
+            auto const row= random.bounded(static_cast<int>(rows.size()));
+            auto const column= random.bounded(columnCount);
+            auto const value= randomRow().at(column);
+            rows[row][column]= value;
+            store.setCell(row, column, value);
+        }
+        // aggregates are read between changes, as formulas do.
+        if(step % 7 == 0)
+            compare(store, rows, columnCount);
+    }
+    compare(store, rows, columnCount);
+}
+
+QTEST_APPLESS_MAIN(ColumnStoreTest)
+
+#include "tst_columnstore.moc"
@@ -0,0 +1,51 @@
+#ifndef TESTFIXTURES_H
+#define TESTFIXTURES_H
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+/**
+ * @brief Json builders shared by the charactersheet tests, they follow the layout of the .rcs files.
+ */
+namespace Fixtures
+{
+inline QJsonObject field(const QString& id, const QString& label, const QString& value, const QString& formula= {})
+{
+    QJsonObject json{{"type", "field"}, {"id", id}, {"label", label}, {"value", value}};
+    if(!formula.isEmpty())
+        json.insert("formula", formula);
+    return json;
+}
+
+/**
+ * @brief table gives a TableField, each line is an array of fields.
+ */
+inline QJsonObject table(const QString& id, const QString& label, const QJsonArray& lines)
+{
+    return {{"type", "TableField"}, {"id", id}, {"label", label}, {"children", lines}};
+}
+
+inline QJsonObject character(const QString& name, const QString& uuid, const QJsonObject& values)
+{
+    return {{"name", name}, {"idSheet", uuid}, {"values", values}};
+}
+
+inline QByteArray compact(const QJsonObject& json)
+{
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+inline QJsonObject rootSection(const QJsonArray& items)
+{
+    return {{"name", "root"}, {"items", items}};
+}
+
+inline QJsonObject file(const QJsonArray& items, const QJsonArray& characters)
+{
+    return {{"data", rootSection(items)}, {"characters", characters}};
+}
+} // namespace Fixtures
+
+#endif // TESTFIXTURES_H
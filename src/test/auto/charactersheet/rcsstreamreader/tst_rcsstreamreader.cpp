@@ -0,0 +1,161 @@
+#include <QBuffer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTest>
+
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "charactersheet/rcsstreamreader.h"
+#include "testfixtures.h"
+
+namespace
+{
+using Fixtures::field;
+
+QJsonObject character(const QString& name, const QString& uuid)
+{
+    return Fixtures::character(name, uuid, QJsonObject{{"id_1", field("id_1", "Name", name)}});
+}
+
+QJsonObject file(const QString& qml)
+{
+    auto json= Fixtures::file(QJsonArray{field("id_1", "Name", "")},
+                              QJsonArray{character("Frodo", "{3b2a1c0d-4e5f-4a6b-8c7d-9e0f1a2b3c01}"),
+                                         character("Sam", "{3b2a1c0d-4e5f-4a6b-8c7d-9e0f1a2b3c02}")});
+    json.insert("background", QJsonArray{});
+    json.insert("qml", qml);
+    json.insert("fonts", QJsonArray{"Uncial", "Gothic"});
+    json.insert("pageCount", 2);
+    json.insert("locked", true);
+    return json;
+}
+
+bool read(const QByteArray& data, CharacterSheetModel& model, QJsonObject* others= nullptr, bool indexed= false)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    RcsStreamReader reader(&buffer);
+    reader.setIndexedCharacters(indexed);
+    auto const ok= reader.read(&model, nullptr);
+    if(nullptr != others)
+        *others= reader.otherValues();
+    if(!ok && reader.errorString().isEmpty())
+        qWarning() << "no error string for a failed read";
+    return ok;
+}
+} // namespace
+
+class RcsStreamReaderTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readTest_data();
+    void readTest();
+    void chunkBoundaryTest();
+    void indexedTest();
+    void truncatedTest();
+    void invalidTest_data();
+    void invalidTest();
+};
+
+void RcsStreamReaderTest::readTest_data()
+{
+    QTest::addColumn<bool>("indented");
+    QTest::newRow("compact") << false;
+    QTest::newRow("indented") << true;
+}
+
+void RcsStreamReaderTest::readTest()
+{
+    QFETCH(bool, indented);
+    auto const format= indented ? QJsonDocument::Indented : QJsonDocument::Compact;
+
+    auto const json= file(QStringLiteral("import QtQuick\nItem { property string text: \"hobbit\" }"));
+    CharacterSheetModel model;
+    QJsonObject others;
+    QVERIFY(read(QJsonDocument(json).toJson(format), model, &others));
+
+    QCOMPARE(model.getCharacterSheetCount(), 2);
+    QCOMPARE(model.getCharacterSheet(0)->name(), QStringLiteral("Frodo"));
+    QCOMPARE(model.getCharacterSheet(1)->getValue("id_1").toString(), QStringLiteral("Sam"));
+
+    // values the reader does not handle are given back as they are.
+    QCOMPARE(others.value("qml"), json.value("qml"));
+    QCOMPARE(others.value("fonts"), json.value("fonts"));
+    QCOMPARE(others.value("pageCount"), json.value("pageCount"));
+    QCOMPARE(others.value("locked"), json.value("locked"));
+    QVERIFY(!others.contains("characters"));
+    QVERIFY(!others.contains("data"));
+}
+
+void RcsStreamReaderTest::chunkBoundaryTest()
+{
+    // strings longer than a read chunk, with escapes at every offset so one of them is cut by a chunk end.
+    QString qml;
+    for(int i= 0; i < 60000; ++i)
+        qml.append(i % 2 ? QStringLiteral("a\"") : QStringLiteral("\\n"));
+    auto const json= file(qml);
+
+    for(int padding= 0; padding < 4; ++padding)
+    {
+        auto data= QJsonDocument(json).toJson(QJsonDocument::Compact);
+        data.prepend(QByteArray(padding, ' '));
+        CharacterSheetModel model;
+        QJsonObject others;
+        QVERIFY(read(data, model, &others));
+        QCOMPARE(others.value("qml").toString(), qml);
+        QCOMPARE(model.getCharacterSheetCount(), 2);
+    }
+}
+
+void RcsStreamReaderTest::indexedTest()
+{
+    CharacterSheetModel model;
+    QVERIFY(read(QJsonDocument(file({})).toJson(), model, nullptr, true));
+    QCOMPARE(model.getCharacterSheetCount(), 2);
+
+    auto sheet= model.getCharacterSheetById(QStringLiteral("3b2a1c0d-4e5f-4a6b-8c7d-9e0f1a2b3c02"));
+    QVERIFY(nullptr != sheet);
+    QCOMPARE(sheet->name(), QStringLiteral("Sam"));
+}
+
+void RcsStreamReaderTest::truncatedTest()
+{
+    auto const data= QJsonDocument(file(QStringLiteral("Item {}"))).toJson(QJsonDocument::Compact);
+    for(qsizetype size= 0; size < data.size(); size+= 7)
+    {
+        CharacterSheetModel model;
+        QVERIFY2(!read(data.left(size), model), qPrintable(QStringLiteral("size %1").arg(size)));
+    }
+    CharacterSheetModel model;
+    QVERIFY(!read(data.chopped(1), model));
+}
+
+void RcsStreamReaderTest::invalidTest_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("array") << QByteArray("[1, 2]");
+    QTest::newRow("no comma") << QByteArray("{\"a\": 1 \"b\": 2}");
+    QTest::newRow("no colon") << QByteArray("{\"a\" 1}");
+    QTest::newRow("key not string") << QByteArray("{a: 1}");
+    QTest::newRow("no value") << QByteArray("{\"a\": , \"b\": 2}");
+    QTest::newRow("characters not array") << QByteArray("{\"characters\": {}}");
+    QTest::newRow("unclosed array") << QByteArray("{\"characters\": [{\"name\": \"x\"}");
+    QTest::newRow("unclosed string") << QByteArray("{\"qml\": \"Item {}");
+    QTest::newRow("trailing escape") << QByteArray("{\"qml\": \"Item\\");
+}
+
+void RcsStreamReaderTest::invalidTest()
+{
+    QFETCH(QByteArray, data);
+    CharacterSheetModel model;
+    QVERIFY(!read(data, model));
+}
+
+QTEST_MAIN(RcsStreamReaderTest)
+
+#include "tst_rcsstreamreader.moc"
@@ -0,0 +1,149 @@
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QPersistentModelIndex>
+#include <QSignalSpy>
+#include <QTest>
+#include <memory>
+
+#include "charactersheet/charactersheet.h"
+#include "charactersheet/charactersheetmodel.h"
+#include "section.h"
+#include "sectiondiff.h"
+#include "testfixtures.h"
+
+namespace
+{
+using Fixtures::field;
+
+QJsonObject typedField(const QString& id, const QString& label, CharacterSheetItem::TypeField type)
+{
+    auto json= field(id, label, "");
+    json.insert("typefield", static_cast<int>(type));
+    return json;
+}
+
+QJsonArray items()
+{
+    return {field("id_1", "Name", ""), field("id_2", "Brave", ""), field("id_3", "Notes", "")};
+}
+
+// id_1 is relabelled, id_2 retyped and moved first, id_3 removed and id_4 added.
+QJsonArray changedItems()
+{
+    return {typedField("id_2", "Brave", CharacterSheetItem::CHECKBOX), field("id_1", "Full name", ""),
+            field("id_4", "Age", "")};
+}
+
+std::unique_ptr<Section> section(const QJsonArray& items)
+{
+    auto root= std::make_unique<Section>();
+    root->load(Fixtures::rootSection(items), nullptr);
+    return root;
+}
+
+QJsonObject character(const QString& name, const QString& uuid)
+{
+    QJsonObject values{{"id_1", field("id_1", "Name", name)},
+                       {"id_2", field("id_2", "Brave", "1")},
+                       {"id_3", field("id_3", "Notes", "ring")}};
+    return Fixtures::character(name, uuid, values);
+}
+
+QStringList ids(const QList<CharacterSheetItem*>& items)
+{
+    QStringList list;
+    for(auto item : items)
+        list << item->getId();
+    list.sort();
+    return list;
+}
+} // namespace
+
+class SectionDiffTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void computeTest();
+    void applyTest();
+    void mergeTest();
+};
+
+void SectionDiffTest::computeTest()
+{
+    auto const from= section(items());
+    auto const to= section(changedItems());
+
+    auto const diff= SectionDiff::compute(from.get(), to.get());
+    QVERIFY(!diff.isEmpty());
+    QCOMPARE(ids(diff.added), QStringList{"id_4"});
+    QCOMPARE(diff.removed, QStringList{"id_3"});
+    QCOMPARE(ids(diff.retyped), QStringList{"id_2"});
+    QCOMPARE(ids(diff.relabelled), QStringList{"id_1"});
+
+    QVERIFY(SectionDiff::compute(from.get(), section(items()).get()).isEmpty());
+}
+
+void SectionDiffTest::applyTest()
+{
+    auto const from= section(items());
+    auto const to= section(changedItems());
+    auto const diff= SectionDiff::compute(from.get(), to.get());
+
+    CharacterSheet sheet;
+    sheet.load(character("Frodo", "{5a4b3c2d-1e0f-4a9b-8c7d-6e5f4a3b2c01}"));
+    diff.applyTo(&sheet);
+
+    // kept fields keep their values, only their schema changes.
+    QVERIFY(!sheet.hasField("id_3"));
+    QVERIFY(sheet.hasField("id_4"));
+    QCOMPARE(sheet.getValue("id_1").toString(), QStringLiteral("Frodo"));
+    QCOMPARE(sheet.getValue("id_2").toString(), QStringLiteral("1"));
+    QCOMPARE(sheet.getFieldFromKey("id_1")->getLabel(), QStringLiteral("Full name"));
+    QCOMPARE(sheet.getFieldFromKey("id_2")->getFieldType(), CharacterSheetItem::CHECKBOX);
+}
+
+void SectionDiffTest::mergeTest()
+{
+    CharacterSheetModel model;
+    model.readModel(Fixtures::file(items(), QJsonArray{character("Frodo", "{5a4b3c2d-1e0f-4a9b-8c7d-6e5f4a3b2c01}"),
+                                                       character("Sam", "{5a4b3c2d-1e0f-4a9b-8c7d-6e5f4a3b2c02}")}),
+                    true);
+    QCOMPARE(model.rowCount(QModelIndex()), 3);
+
+    QPersistentModelIndex name(model.index(0, 1));
+    QCOMPARE(name.data().toString(), QStringLiteral("Frodo"));
+
+    QSignalSpy reset(&model, &CharacterSheetModel::modelAboutToBeReset);
+    QSignalSpy removed(&model, &CharacterSheetModel::rowsRemoved);
+    QSignalSpy inserted(&model, &CharacterSheetModel::rowsInserted);
+    QSignalSpy moved(&model, &CharacterSheetModel::rowsMoved);
+
+    // the previous structure is given back to the caller with the items which are not used anymore.
+    std::unique_ptr<Section> previous(model.getRootSection());
+    auto next= section(changedItems());
+    model.setRootSection(next.release());
+
+    QCOMPARE(reset.size(), 0);
+    QCOMPARE(removed.size(), 1);
+    QCOMPARE(removed.first().at(1).toInt(), 2);
+    QCOMPARE(removed.first().at(2).toInt(), 2);
+    QCOMPARE(moved.size(), 1);
+    QCOMPARE(inserted.size(), 1);
+    QCOMPARE(inserted.first().at(1).toInt(), 2);
+
+    // views keep their indexes, they follow the moved row.
+    QCOMPARE(model.rowCount(QModelIndex()), 3);
+    QVERIFY(name.isValid());
+    QCOMPARE(name.row(), 1);
+    QCOMPARE(name.data().toString(), QStringLiteral("Frodo"));
+    QCOMPARE(model.index(1, 0).data().toString(), QStringLiteral("Full name"));
+    QCOMPARE(model.index(0, 2).data().toString(), QStringLiteral("1"));
+    QCOMPARE(model.index(2, 0).data().toString(), QStringLiteral("Age"));
+    QVERIFY(model.getCharacterSheet(1)->hasField("id_4"));
+    QVERIFY(!model.getCharacterSheet(1)->hasField("id_3"));
+}
+
+QTEST_MAIN(SectionDiffTest)
+
+#include "tst_sectiondiff.moc"
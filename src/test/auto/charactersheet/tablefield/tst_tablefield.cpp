@@ -0,0 +1,157 @@
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSignalSpy>
+#include <QTest>
+
+#include "tablefield.h"
+#include "testfixtures.h"
+
+namespace
+{
+using Fixtures::field;
+
+// item, count, price, total and total with tax: the last two are the computed columns.
+QJsonArray line(int i)
+{
+    return {field("id_t_1", "Item", QStringLiteral("item %1").arg(i)), field("id_t_2", "Count", QString::number(i + 1)),
+            field("id_t_3", "Price", "2"), field("id_t_4", "Total", ""), field("id_t_5", "Taxed", "")};
+}
+
+void fill(TableField& table, int lineCount)
+{
+    QJsonArray lines;
+    for(int i= 0; i < lineCount; ++i)
+        lines.append(line(i));
+    table.loadDataItem(Fixtures::table("id_t", "Inventory", lines));
+}
+
+QString cell(TableField& table, int line, int column)
+{
+    return table.getModel()->getField(line, column)->value();
+}
+} // namespace
+
+class TableFieldTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void computedColumnTest();
+    void rangeTest();
+    void cellIndexTest();
+};
+
+void TableFieldTest::computedColumnTest()
+{
+    TableField table;
+    fill(table, 120);
+    auto model= table.getModel();
+    QCOMPARE(model->lineCount(), 120);
+
+    table.setColumnFormula(4, "=${Total}+1");
+    QSignalSpy dataChanged(model, &LineModel::dataChanged);
+    QSignalSpy contentChanged(model, &LineModel::contentChanged);
+
+    // the column and the one computed from it are written with a single notification.
+    table.setColumnFormula(3, "=${Count}*${Price}");
+    QCOMPARE(dataChanged.size(), 1);
+    QCOMPARE(contentChanged.size(), 1);
+    QCOMPARE(dataChanged.first().at(0).toModelIndex().row(), 0);
+    QCOMPARE(dataChanged.first().at(1).toModelIndex().row(), model->rowCount(QModelIndex()) - 1);
+
+    // lines not built yet hold the results too.
+    auto const lines= model->lines();
+    QCOMPARE(lines.at(100).at(3).value, QStringLiteral("202"));
+    QCOMPARE(lines.at(100).at(4).value, QStringLiteral("203"));
+    QCOMPARE(cell(table, 0, 3), QStringLiteral("2"));
+    QCOMPARE(cell(table, 119, 4), QStringLiteral("241"));
+    QCOMPARE(table.columnFormula(3), QStringLiteral("=${Count}*${Price}"));
+
+    // an edited input computes its line again.
+    model->getField(5, 1)->setValue("10");
+    QCOMPARE(cell(table, 5, 3), QStringLiteral("20"));
+    QCOMPARE(cell(table, 5, 4), QStringLiteral("21"));
+    QCOMPARE(cell(table, 6, 3), QStringLiteral("14"));
+
+    // formulas are saved with the lines.
+    QJsonObject json;
+    table.saveDataItem(json);
+    TableField loaded;
+    loaded.loadDataItem(json);
+    QCOMPARE(loaded.columnFormula(3), table.columnFormula(3));
+    QCOMPARE(loaded.getModel()->lines().at(5).at(4).value, QStringLiteral("21"));
+}
+
+void TableFieldTest::rangeTest()
+{
+    TableField table;
+    fill(table, 3);
+    auto model= table.getModel();
+
+    QSignalSpy inserted(model, &LineModel::rowsInserted);
+    QSignalSpy removed(model, &LineModel::rowsRemoved);
+    QSignalSpy lineCountChanged(model, &LineModel::lineCountChanged);
+
+    // new lines copy the last one and are notified once.
+    table.insertLines(1, 100);
+    QCOMPARE(model->lineCount(), 103);
+    QCOMPARE(inserted.size(), 1);
+    QCOMPARE(inserted.first().at(1).toInt(), 1);
+    QCOMPARE(inserted.first().at(2).toInt(), 100);
+    QCOMPARE(lineCountChanged.size(), 1);
+    QCOMPARE(model->lines().at(50).at(0).value, QStringLiteral("item 2"));
+    QCOMPARE(model->lines().at(101).at(0).value, QStringLiteral("item 1"));
+
+    table.removeLines(10, 90);
+    QCOMPARE(model->lineCount(), 22);
+    QCOMPARE(removed.size(), 1);
+    QCOMPARE(removed.first().at(1).toInt(), 10);
+    QCOMPARE(removed.first().at(2).toInt(), 90);
+    QCOMPARE(lineCountChanged.size(), 2);
+
+    // lines after the range move up.
+    auto const lines= model->lines();
+    QCOMPARE(lines.at(0).at(0).value, QStringLiteral("item 0"));
+    QCOMPARE(lines.at(20).at(0).value, QStringLiteral("item 1"));
+    QCOMPARE(lines.at(21).at(0).value, QStringLiteral("item 2"));
+    QCOMPARE(cell(table, 21, 1), QStringLiteral("3"));
+}
+
+void TableFieldTest::cellIndexTest()
+{
+    TableField table;
+    fill(table, 3);
+    auto model= table.getModel();
+
+    // lines share the ids, the first line answers for the table.
+    auto first= model->getFieldById("id_t_2");
+    QVERIFY(first != nullptr);
+    QCOMPARE(first, model->getField(0, 1));
+    QCOMPARE(table.getChildFromId("id_t_2"), static_cast<CharacterSheetItem*>(first));
+    QCOMPARE(model->lineOfField(first), 0);
+    auto last= model->getFieldById(2, "id_t_2");
+    QCOMPARE(model->lineOfField(last), 2);
+    QVERIFY(model->getFieldById(3, "id_t_2") == nullptr);
+
+    auto json= field("id_t_2", "Count", "42");
+    json.insert("line", 2);
+    model->setChildFieldData(json);
+    QCOMPARE(cell(table, 2, 1), QStringLiteral("42"));
+    QCOMPARE(cell(table, 0, 1), QStringLiteral("1"));
+    QCOMPARE(cell(table, 1, 1), QStringLiteral("2"));
+
+    // removed lines move the index.
+    table.removeLines(0, 0);
+    QCOMPARE(model->getFieldById(1, "id_t_2")->value(), QStringLiteral("42"));
+    QCOMPARE(model->lineOfField(last), 1);
+
+    auto renamed= model->getFieldById(0, "id_t_1");
+    renamed->setId("renamed");
+    QCOMPARE(model->getFieldById(0, "renamed"), renamed);
+    QVERIFY(model->getFieldById(0, "id_t_1") == nullptr);
+    QCOMPARE(model->getFieldById("id_t_1"), model->getField(1, 0));
+}
+
+QTEST_MAIN(TableFieldTest)
+
+#include "tst_tablefield.moc"